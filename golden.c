@@ -0,0 +1,135 @@
+#include "port.h"
+
+// Golden-frame regression run (headless):
+// renders a few scripted scenes and compares their hashes against
+// golden.txt, then diffs optimized kernels against scalar references.
+//   gcc golden.c -o golden -lSDL2 -lSDL2_ttf -lm && ./golden
+// Exits with 1 on any mismatch (frames that differ are saved as
+// golden.txt.<scene>.ppm). Unknown scenes get recorded, so after an
+// intended change to the output delete their lines and run it again.
+// [!] scenes stick to values float math represents exactly, so their
+//     hashes don't depend on compiler flags (e.g. FMA contraction)
+
+#define GOLDEN "golden.txt"
+
+defineCanvas(screen, 64, 48)
+
+// everything that writes pixels directly (drawLine() isn't implemented yet)
+static void scenePixels() {
+  win->setClearColor(clrBlack);
+  win->clear();
+  // spans through the fixed-size canvas and the generic one
+  Uint32 *px = screenBind();
+  for (int y = 0; y < screenH; y += 3) screenSpan(px, y % 17, y, 40, 0xff000000 | y * 0x050301);
+  Canvas c = canvasFromWindow();
+  for (int x = 0; x < c.w; x += 5) pxSpan(c, x / 2, 46 - x / 4, 9, pxFromRGBA(255, x * 4, 0, 255));
+  screenPut(px, 63, 47, 0xffffffff);
+  // a point cloud, some points off screen
+  SDL_Point points[96];
+  Uint32 colors[96];
+  for (int i = 0; i < 96; i++) {
+    points[i] = (SDL_Point){(i * 37) % 80 - 8, (i * 23) % 60 - 6};
+    colors[i] = 0xff00ff00 | i;
+  }
+  win->drawPixels(points, colors, 96);
+  win->drawSetColor(0xff8000, 255);
+  win->drawPixels(points, NULL, 12);
+  // an image clipped by the top-left and the right edges
+  Uint32 img[10 * 7];
+  for (int i = 0; i < 10 * 7; i++) img[i] = 0xff000000 | (i * 0x030507);
+  Image image = {img, 10, 7};
+  win->drawImage(&image, -3, -2);
+  win->drawImage(&image, 58, 20);
+}
+
+static void sceneParticles() {
+  win->setClearColor(clrBlue);
+  win->clear();
+  Particles *p = particlesNew(509); // odd count: SIMD body and scalar tail
+  for (int i = 0; i < 509; i++) {
+    particlesAdd(p, i % 61, i % 7, (i % 9) - 4, (i % 5) * 2, 0xff000000 | i * 0x010307);
+  }
+  for (int i = 0; i < 4; i++) particlesStep(p, 0.25f, 0, 8);
+  particlesDraw(p);
+  particlesFree(p);
+}
+
+static void sceneTilemap() {
+  // 2 tiles 8x8: a gradient and a frame
+  Uint32 atlas[16 * 8];
+  for (int y = 0; y < 8; y++) {
+    for (int x = 0; x < 8; x++) {
+      atlas[y * 16 + x] = 0xff000000 | (x * 32) << 16 | (y * 32);
+      atlas[y * 16 + 8 + x] = (x % 7 == 0 || y % 7 == 0) ? 0xffffffff : 0xff404040;
+    }
+  }
+  Tileset *ts = tilesetNew(atlas, 16, 8, 8, 8);
+  Tilemap *tm = tilemapNew(ts, 11, 9);
+  for (int i = 0; i < 11 * 9; i++) tilemapSet(tm, i % 11, i / 11, (i % 3) == 0);
+  tilemapDraw(tm);
+  tilemapScroll(tm, 13, 5);
+  tilemapScroll(tm, -3, 30);
+  tilemapSet(tm, 4, 4, 0);
+  tilemapFree(tm);
+  tilesetFree(ts);
+}
+
+static void sceneMesh() {
+  static float pos[] = {
+    -1.0f, -1.0f, 0.5f,    1.0f, -0.5f, 0.5f,    0.0f, 1.0f, 0.5f,
+    -0.75f, 0.75f, 0.0f,   0.75f, 0.5f, 0.0f,    0.25f, -1.5f, 0.0f,
+  };
+  static Uint32 colors[] = {
+    0xffff0000, 0xffff0000, 0xffff0000, 0xff00ff00, 0xff00ff00, 0xff00ff00,
+  };
+  static int idx[] = {0, 1, 2, 3, 4, 5};
+  Mesh mesh = {pos, colors, idx, 6, 2};
+  win->setClearColor(clrBlack);
+  win->clear();
+  depthClear();
+  Mat4 mvp = mat4Identity();
+  drawMesh(&mesh, &mvp, shadeFLAT | cullNONE);
+  // smaller copy in front, its second (clockwise) triangle gets culled
+  Mat4 scale = mat4Scale(0.5f, 0.5f, 0.5f);
+  Mat4 move = mat4Translate(0.25f, 0, -0.5f);
+  mvp = mat4Mul(&move, &scale);
+  drawMesh(&mesh, &mvp, shadeFLAT);
+}
+
+static void scenePost() {
+  Canvas c = canvasFromWindow();
+  for (int y = 0; y < c.h; y++) {
+    for (int x = 0; x < c.w; x++) pxPut(c, x, y, pxFromRGBA(x * 4, y * 5, 255 - x * 4, 255));
+  }
+  Uint8 inv[256];
+  for (int i = 0; i < 256; i++) inv[i] = 255 - i;
+  postSetLUT(inv, inv, inv);
+  postSetCRT(0.5f, true);
+  postSetDither(4);
+}
+
+int main() {
+  SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+  Window *w = newWindow(160, 120);
+  w->setLogicalSize(64, 48);      // 2.5x, nearest neighbor stepping
+
+  struct { const char *name; void (*scene)(); } scenes[] = {
+    {"pixels", scenePixels},
+    {"particles", sceneParticles},
+    {"tilemap", sceneTilemap},
+    {"mesh", sceneMesh},
+    {"post", scenePost},
+  };
+  int failed = 0;
+  for (size_t i = 0; i < sizeof(scenes) / sizeof(scenes[0]); i++) {
+    failed += !goldenScene(GOLDEN, scenes[i].name, scenes[i].scene);
+    // back to defaults for the next scene
+    postClear();
+    w->setScroll(0, 0);
+  }
+  failed += verifyKernels(500, 1) > 0;
+
+  printf("[golden] %s\n", failed ? "FAILED" : "ok");
+  w->exit();
+  return failed ? 1 : 0;
+}
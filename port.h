@@ -11,14 +11,41 @@
 #include <math.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <ctype.h>
 #ifdef _WIN32
 #include <Windows.h>
 #else
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif
 // vendor
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
+// simd
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PORT_SSE2
+#endif
+// SSSE3 kernels are built anyway with GCC/clang and picked at runtime
+#if defined(__SSSE3__) || (defined(PORT_SSE2) && defined(__GNUC__))
+#include <tmmintrin.h>
+#define PORT_SSSE3
+#endif
+// code between these keeps a * b + c as two roundings (never fused into an
+// FMA), so vector kernels match their scalar references bit for bit
+#if defined(__clang__)
+  #define PORT_EXACT_FP_BEGIN _Pragma("STDC FP_CONTRACT OFF")
+  #define PORT_EXACT_FP_END   _Pragma("STDC FP_CONTRACT DEFAULT")
+#elif defined(__GNUC__)
+  #define PORT_EXACT_FP_BEGIN \
+    _Pragma("GCC push_options") _Pragma("GCC optimize(\"fp-contract=off\")")
+  #define PORT_EXACT_FP_END   _Pragma("GCC pop_options")
+#else
+  #define PORT_EXACT_FP_BEGIN
+  #define PORT_EXACT_FP_END
+#endif
 
 //////////////////////////////////////////////////////////////////////////////
 // API ///////////////////////////////////////////////////////////////////////
@@ -47,6 +74,8 @@
 // setFullscreen -
 // setLogicalSize +
 // setPxRaw +
+// setScroll +
+// shareFramebuffer +
 
 // [Window] Event handling operations
 // wait +
@@ -58,6 +87,8 @@
 // drawSetColor +
 // drawPx +
 // drawPxRaw +
+// drawPixels +
+// drawImage +
 // drawLine .
 // drawHorLine -
 // drawVerLine -
@@ -75,9 +106,63 @@
 // [Window] Screen operations
 // scrSetResolution .
 
+// [Tilemap] Scrolling tile layer
+// tilesetNew +
+// tilemapNew +
+// tilemapSet +
+// tilemapDraw +
+// tilemapScroll +
+
+// [3D] Software 3D pipeline
+// mat4* +
+// transformVertices +
+// meshNew +
+// depthClear +
+// drawMesh +
+
+// [Canvas] Direct pixel access (inline)
+// canvasFromWindow +
+// pxRow +
+// pxPut +
+// pxGet +
+// pxSpan +
+// defineCanvas +
+
+// [Image] Loading
+// imageLoad +
+// imageLoadUncached +
+// imageCacheClear +
+
+// [Post] Effects fused into the upscale pass
+// postSetGrading +
+// postSetLUT +
+// postSetCRT +
+// postSetDither +
+// postClear +
+
+// [Adaptive] Logical resolution driven by frame time
+// adaptiveResolution +
+// adaptiveResolutionOff +
+
+// [Verify] Golden frames & kernel diffing
+// hashPixels +
+// frameHash +
+// goldenCheck +
+// goldenScene +
+// verifyKernels +
+
+// [Memory] Scratch & recurring allocations
+// arenaAlloc +
+// arenaReset +
+// frameAlloc +
+// poolGet +
+// poolPut +
+
 // [Window] Misc operations
 // info +
 
+struct Image; // see IMAGES below
+
 typedef struct Window {
   // window
   SDL_Window *window;     // [SDL] representation of 'window'
@@ -105,12 +190,36 @@ typedef struct Window {
   int vbufw, vbufh;       // its width/height in pixels
   size_t vbufSize;        // its size in bytes (vbufw * vbufh * 4)
 
+  // scroll registers
+  int scrollx, scrolly;   // logical vbuffer origin, wraps around the edges
+                          // (applied upon render, vbuffer itself isn't moved)
+  char *presentBuf;       // render target for scrolling when vbuf == buf
+  Uint32 *presented;      // physical frame uploaded by the last update()
+
+  // depth buffer (3D)
+  float *zbuf;            // depth per logical pixel, 0 (near) .. 1 (far)
+  float *zmax;            // farthest depth per 8x8 block (early reject)
+  int zbufw, zbufh;       // its width/height (follows vbuffer)
+  size_t zbufCap, zmaxCap; // number of elements they're allocated for
+
   // printing
   TTF_Font *font;         // [SDL]
   SDL_Color fontColor;
   unsigned int fontSize;
   char *fontPath;
 
+  // adaptive resolution
+  struct AdaptiveRes *adapt; // logical size controller (NULL if off)
+
+  // post-processing
+  struct PostFx *post;    // effects applied upon render (NULL if none)
+
+  // sharing
+  struct FbShare *share;  // shared memory export of presented frames
+
+  // memory
+  struct Arena *frame;    // per-frame scratch memory, reset upon update()
+
   // colors
   Uint32 drawColor;       // default drawing color
   Uint32 clearColor;      // raw 'wipe out' color
@@ -133,6 +242,8 @@ typedef struct Window {
   void (*setPxRaw)(int x, int y, Uint32 px);
   void (*setLogicalSize)(int w, int h);
   void (*UnsetLogicalSize)();
+  void (*setScroll)(int x, int y);
+  int (*shareFramebuffer)(const char *name);
 
   // window events
   void (*wait)(Uint32);
@@ -147,6 +258,8 @@ typedef struct Window {
   void (*drawRect)();
   void (*drawPx)(int x, int y);
   void (*drawPxRaw)(int x, int y, Uint32 px);
+  void (*drawPixels)(const SDL_Point *points, const Uint32 *colors, size_t n);
+  void (*drawImage)(const struct Image *img, int x, int y);
 
   // printing commands
   void (*printSetFont)(const char * fontpath);
@@ -161,11 +274,21 @@ typedef struct Window {
 
 Window *win; // trick to eliminate passing struct in `win->method(win, ...)`
 
+// scratch memory valid until the next update()
+#define frameAlloc(size) arenaAlloc(win->frame, (size))
+
 //////////////////////////////////////////////////////////////////////////////
 // MISC //////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
 
 #define max(x, y) ((x) >= (y) ? (x) : (y))
+#define min(x, y) ((x) <= (y) ? (x) : (y))
+
+// modulo that stays positive for negative A (e.g. modWrap(-1, 8) == 7)
+static inline int modWrap(int a, int m) {
+  int r = a % m;
+  return r < 0 ? r + m : r;
+}
 
 // setter toggles
 #define yes     1
@@ -305,6 +428,8 @@ static void memSet32(Uint32 *dst, Uint32 blk, size_t n) {
 #define bufEnd(b) ((b) + bufLen(b))
 // free memory for buffer if it is not NULL
 #define bufFree(b) ((b) ? (free(bufGetHdr(b)), (b) = NULL) : 0)
+// drop all elements keeping the capacity
+#define bufClear(b) ((b) ? (bufGetHdr(b)->len = 0) : 0)
 
 // "Private" implementation
 
@@ -321,7 +446,13 @@ typedef struct BufHdr {
 #define bufCanFit(b, n) (bufLen(b) + (n) <= bufCap(b))
 // check if the buffer can fit new elements otherwise expand
 #define bufMustFit(b, n) \
-  (bufCanFit(b, n) ? 0 : ((b) = bufNewOrExpand(b, bufLen(b) + n, sizeof(*b))))
+  (bufCanFit(b, n) ? 0 : ((b) = bufCast(b)bufNewOrExpand(b, bufLen(b) + n, sizeof(*b))))
+// C++ doesn't convert void * implicitly
+#ifdef __cplusplus
+  #define bufCast(b) (decltype(b))
+#else
+  #define bufCast(b)
+#endif
 
 void *bufNewOrExpand(const void *buf, size_t new_len, size_t elem_size) {
   // check if we can double the current capacity without number overflow
@@ -346,6 +477,120 @@ void *bufNewOrExpand(const void *buf, size_t new_len, size_t elem_size) {
   return new_hdr->buf;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// ARENA & POOL //////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+// Arena is a linear allocator: allocation is a pointer bump, and everything
+// is released at once by arenaReset(). Requests that don't fit go to separate
+// overflow blocks; upon reset those are folded into one bigger block, so after
+// a few warm-up frames the arena stops touching the heap altogether.
+
+#define arenaALIGN (16) // enough for any SSE load/store
+
+typedef struct Arena {
+  char *base;             // current block
+  size_t cap;             // its size in bytes
+  size_t used;            // bytes handed out from it
+  size_t spilled;         // bytes handed out from overflow blocks
+  char **overflow;        // overflow blocks (dynamic array)
+} Arena;
+
+static Arena *arenaNew(size_t cap) {
+  Arena *a = (Arena *)calloc(1, sizeof(Arena));
+  assertWithMsg(a != NULL, "failed to allocate memory for arena");
+  a->base = (char *)malloc(cap);
+  assertWithMsg(a->base != NULL || cap == 0, "failed to allocate memory for arena");
+  a->cap = cap;
+  return a;
+}
+
+static void *arenaAlloc(Arena *a, size_t size) {
+  size = (size + arenaALIGN - 1) & ~(size_t)(arenaALIGN - 1);
+  if (a->cap - a->used >= size) {
+    void *p = a->base + a->used;
+    a->used += size;
+    return p;
+  }
+  // doesn't fit, spill into a dedicated block until the next reset
+  char *p = (char *)malloc(size);
+  assertWithMsg(p != NULL, "failed to allocate memory for arena overflow");
+  bufPush(a->overflow, p);
+  a->spilled += size;
+  return p;
+}
+
+// release everything allocated so far, O(1) once the arena has settled
+static void arenaReset(Arena *a) {
+  if (bufLen(a->overflow) > 0) {
+    for (size_t i = 0; i < bufLen(a->overflow); i++) free(a->overflow[i]);
+    bufClear(a->overflow);
+    // grow to hold the whole peak usage in one block
+    size_t cap = max(a->cap * 2, a->used + a->spilled);
+    free(a->base);
+    a->base = (char *)malloc(cap);
+    assertWithMsg(a->base != NULL, "failed to allocate memory for arena");
+    memset(a->base, 0, cap); // fault the pages in now, not mid-frame
+    a->cap = cap;
+    a->spilled = 0;
+  }
+  a->used = 0;
+}
+
+static void arenaFree(Arena *a) {
+  if (a == NULL) return;
+  for (size_t i = 0; i < bufLen(a->overflow); i++) free(a->overflow[i]);
+  bufFree(a->overflow);
+  free(a->base);
+  free(a);
+}
+
+// Pool hands out fixed-size elements; freed ones are kept in an intrusive
+// free list and reused before any new block is allocated.
+
+typedef struct Pool {
+  size_t elemSize;        // element size in bytes (>= pointer size)
+  size_t perBlock;        // elements per allocated block
+  void *freeList;         // first free element, it stores the next one
+  char **blocks;          // allocated blocks (dynamic array)
+} Pool;
+
+static Pool *poolNew(size_t elemSize, size_t perBlock) {
+  Pool *p = (Pool *)calloc(1, sizeof(Pool));
+  assertWithMsg(p != NULL, "failed to allocate memory for pool");
+  p->elemSize = (max(elemSize, sizeof(void *)) + arenaALIGN - 1) & ~(size_t)(arenaALIGN - 1);
+  p->perBlock = max(perBlock, 1);
+  return p;
+}
+
+static void *poolGet(Pool *p) {
+  if (p->freeList == NULL) { // thread a new block into the free list
+    char *block = (char *)malloc(p->elemSize * p->perBlock);
+    assertWithMsg(block != NULL, "failed to allocate memory for pool block");
+    bufPush(p->blocks, block);
+    for (size_t i = 0; i < p->perBlock; i++) {
+      char *elem = block + i * p->elemSize;
+      *(void **)elem = i + 1 < p->perBlock ? elem + p->elemSize : NULL;
+    }
+    p->freeList = block;
+  }
+  void *elem = p->freeList;
+  p->freeList = *(void **)elem;
+  return elem;
+}
+
+static void poolPut(Pool *p, void *elem) {
+  *(void **)elem = p->freeList;
+  p->freeList = elem;
+}
+
+static void poolFree(Pool *p) {
+  if (p == NULL) return;
+  for (size_t i = 0; i < bufLen(p->blocks); i++) free(p->blocks[i]);
+  bufFree(p->blocks);
+  free(p);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // PRINT /////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
@@ -402,6 +647,375 @@ static void port_print(const char* str, int x, int y) {
   SDL_RenderPresent(win->renderer);
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// IMAGES ////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+// Loaders for simple formats (binary PPM, uncompressed BMP, QOI). Files are
+// mmap'ed and decoded straight into ARGB8888 pixels ready to be blitted with
+// drawImage(). imageLoad() caches decoded images by path.
+
+typedef struct Image {
+  Uint32 *px;             // ARGB pixels, row by row, no padding
+  int w, h;               // width/height in pixels
+} Image;
+
+// 64bit FNV-1a hash of a string
+static Uint64 hashStr(const char *s) {
+  Uint64 h = 0xcbf29ce484222325ULL;
+  while (*s) h = (h ^ (Uint8)*s++) * 0x100000001b3ULL;
+  return h;
+}
+
+// map the whole file into memory (read-only), NULL if it can't be opened
+static const Uint8 *port_mapFile(const char *path, size_t *size) {
+#ifndef _WIN32
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat st;
+  void *mem = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    mem = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd); // the mapping stays valid
+  if (mem == MAP_FAILED) return NULL;
+  *size = st.st_size;
+  return (const Uint8 *)mem;
+#else // [TODO] MapViewOfFile()
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) return NULL;
+  fseek(f, 0, SEEK_END);
+  long len = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  Uint8 *mem = len > 0 ? (Uint8 *)malloc(len) : NULL;
+  if (mem != NULL && fread(mem, 1, len, f) != (size_t)len) {
+    free(mem);
+    mem = NULL;
+  }
+  fclose(f);
+  *size = len;
+  return mem;
+#endif
+}
+
+static void port_unmapFile(const Uint8 *mem, size_t size) {
+#ifndef _WIN32
+  munmap((void *)mem, size);
+#else
+  free((void *)mem);
+#endif
+}
+
+static Image *port_imageNew(int w, int h) {
+  assertWithMsg(w > 0 && h > 0 && (size_t)w * h <= SIZE_MAX / 4 / 2,
+    "image size is either 0 or too big");
+  Image *img = (Image *)malloc(sizeof(Image));
+  assertWithMsg(img != NULL, "failed to allocate memory for image");
+  img->w = w;
+  img->h = h;
+  img->px = (Uint32 *)malloc((size_t)w * h * 4);
+  assertWithMsg(img->px != NULL, "failed to allocate memory for image pixels");
+  return img;
+}
+
+static void imageFree(Image *img) {
+  if (img == NULL) return;
+  free(img->px);
+  free(img);
+}
+
+// convert N packed 24bit pixels into opaque ARGB (scalar reference version),
+// BGR tells the source byte order is B, G, R (BMP) rather than R, G, B (PPM)
+static void port_px24ToARGBScalar(const Uint8 *src, Uint32 *dst, size_t n,
+  bool bgr) {
+  int r = bgr ? 2 : 0, b = bgr ? 0 : 2;
+  for (size_t i = 0; i < n; i++, src += 3) {
+    dst[i] = pxFromRGBA(src[r], src[1], src[b], 255);
+  }
+}
+
+#ifdef PORT_SSSE3
+// the same, 4 pixels per byte shuffle
+#if !defined(__SSSE3__)
+__attribute__((target("ssse3")))
+#endif
+static void port_px24ToARGBSSSE3(const Uint8 *src, Uint32 *dst, size_t n,
+  bool bgr) {
+  // destination bytes (little-endian ARGB) are B, G, R, A per pixel
+  __m128i mask = bgr ?
+    _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1) :
+    _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+  __m128i alpha = _mm_set1_epi32((int)0xff000000);
+  size_t i = 0;
+  // a 16 byte load covers 5 and a third pixels, stop before overreading
+  for (; i + 6 <= n; i += 4, src += 12) {
+    __m128i px = _mm_loadu_si128((const __m128i *)src);
+    px = _mm_or_si128(_mm_shuffle_epi8(px, mask), alpha);
+    _mm_storeu_si128((__m128i *)(dst + i), px);
+  }
+  port_px24ToARGBScalar(src, dst + i, n - i, bgr);
+}
+#endif
+
+// if the CPU runs SSSE3 code (known at compile time or checked once)
+static bool port_hasSSSE3() {
+#if defined(__SSSE3__)
+  return true;
+#elif defined(PORT_SSSE3)
+  static int has = -1;
+  if (has < 0) has = __builtin_cpu_supports("ssse3") != 0;
+  return has;
+#else
+  return false;
+#endif
+}
+
+static void port_px24ToARGB(const Uint8 *src, Uint32 *dst, size_t n, bool bgr) {
+#ifdef PORT_SSSE3
+  if (port_hasSSSE3()) {
+    port_px24ToARGBSSSE3(src, dst, n, bgr);
+    return;
+  }
+#endif
+  port_px24ToARGBScalar(src, dst, n, bgr);
+}
+
+// skip whitespace and #comments of a PPM header, then read a number
+static int port_ppmNumber(const Uint8 **p, const Uint8 *end) {
+  while (*p < end && (isspace(**p) || **p == '#')) {
+    if (**p == '#') while (*p < end && **p != '\n') (*p)++;
+    else (*p)++;
+  }
+  int n = 0;
+  while (*p < end && isdigit(**p) && n < (1 << 24)) n = n * 10 + (*(*p)++ - '0');
+  return n;
+}
+
+// binary PPM (P6) with 8bit channels
+static Image *port_decodePPM(const Uint8 *data, size_t size) {
+  const Uint8 *p = data + 2, *end = data + size;
+  int w = port_ppmNumber(&p, end);
+  int h = port_ppmNumber(&p, end);
+  int maxval = port_ppmNumber(&p, end);
+  p++; // single whitespace before the raster
+  assertWithMsg(maxval == 255, "only 8bit PPM images are supported");
+  assertWithMsg(w > 0 && h > 0 && p <= end && (size_t)(end - p) / 3 / w >= (size_t)h,
+    "PPM image is truncated or malformed");
+  Image *img = port_imageNew(w, h);
+  port_px24ToARGB(p, img->px, (size_t)w * h, false); // rows aren't padded
+  return img;
+}
+
+#define port_le16(p) ((Uint32)(p)[0] | (Uint32)(p)[1] << 8)
+#define port_le32(p) (port_le16(p) | port_le16((p) + 2) << 16)
+#define port_be32(p) ((Uint32)(p)[0] << 24 | (Uint32)(p)[1] << 16 | \
+                      (Uint32)(p)[2] << 8 | (Uint32)(p)[3])
+
+// uncompressed BMP: 24bit, 32bit (BI_RGB or ARGB BI_BITFIELDS)
+static Image *port_decodeBMP(const Uint8 *data, size_t size) {
+  assertWithMsg(size >= 54, "BMP image is truncated");
+  Uint32 offset = port_le32(data + 10);
+  Uint32 hdrSize = port_le32(data + 14);
+  int w = (int)port_le32(data + 18);
+  int h = (int)port_le32(data + 22);
+  int bpp = port_le16(data + 28);
+  Uint32 compression = port_le32(data + 30);
+  bool bottomUp = h > 0;
+  h = abs(h);
+
+  bool hasAlpha = false;
+  if (compression == 3 && bpp == 32) { // BI_BITFIELDS, accept ARGB layout only
+    const Uint8 *m = data + 14 + (hdrSize >= 56 ? 40 : hdrSize);
+    assertWithMsg(size >= (size_t)(m - data) + 12 &&
+      port_le32(m) == 0xff0000 && port_le32(m + 4) == 0xff00 && port_le32(m + 8) == 0xff,
+      "only ARGB channel masks are supported for BMP bitfields");
+    hasAlpha = hdrSize >= 56 && port_le32(m + 12) == 0xff000000;
+  } else {
+    assertWithMsg(compression == 0 && (bpp == 24 || bpp == 32),
+      "only uncompressed 24/32bit BMP images are supported");
+  }
+
+  size_t pitch = ((size_t)w * bpp / 8 + 3) & ~(size_t)3; // rows are 4b aligned
+  assertWithMsg(w > 0 && h > 0 && offset <= size && (size - offset) / pitch >= (size_t)h,
+    "BMP image is truncated or malformed");
+  Image *img = port_imageNew(w, h);
+  for (int y = 0; y < h; y++) {
+    const Uint8 *src = data + offset + pitch * (bottomUp ? h - 1 - y : y);
+    Uint32 *dst = img->px + (size_t)y * w;
+    if (bpp == 24) {
+      port_px24ToARGB(src, dst, w, true);
+    } else { // BGRA in memory is already ARGB little-endian
+      memcpy(dst, src, (size_t)w * 4);
+      if (!hasAlpha) for (int x = 0; x < w; x++) dst[x] |= 0xff000000;
+    }
+  }
+  return img;
+}
+
+// QOI, see https://qoiformat.org/qoi-specification.pdf
+static Image *port_decodeQOI(const Uint8 *data, size_t size) {
+  assertWithMsg(size >= 14 + 8, "QOI image is truncated");
+  int w = (int)port_be32(data + 4);
+  int h = (int)port_be32(data + 8);
+  Image *img = port_imageNew(w, h);
+
+  Uint8 index[64][4] = {{0}};  // previously seen pixels (r, g, b, a)
+  Uint8 px[4] = {0, 0, 0, 255};
+  const Uint8 *p = data + 14, *end = data + size - 8; // 8 byte end marker
+  size_t n = (size_t)w * h;
+  for (size_t i = 0; i < n; ) {
+    int run = 1;
+    if (p < end) {
+      Uint8 b = *p++;
+      if (b == 0xfe && p + 3 <= end) {        // QOI_OP_RGB
+        px[0] = p[0]; px[1] = p[1]; px[2] = p[2];
+        p += 3;
+      } else if (b == 0xff && p + 4 <= end) { // QOI_OP_RGBA
+        px[0] = p[0]; px[1] = p[1]; px[2] = p[2]; px[3] = p[3];
+        p += 4;
+      } else if ((b >> 6) == 0) {             // QOI_OP_INDEX
+        memcpy(px, index[b], 4);
+      } else if ((b >> 6) == 1) {             // QOI_OP_DIFF
+        px[0] += ((b >> 4) & 3) - 2;
+        px[1] += ((b >> 2) & 3) - 2;
+        px[2] += (b & 3) - 2;
+      } else if ((b >> 6) == 2 && p < end) {  // QOI_OP_LUMA
+        int dg = (b & 0x3f) - 32;
+        Uint8 b2 = *p++;
+        px[0] += dg - 8 + (b2 >> 4);
+        px[1] += dg;
+        px[2] += dg - 8 + (b2 & 0xf);
+      } else if ((b >> 6) == 3) {             // QOI_OP_RUN (0xfe/0xff excluded)
+        run = (b & 0x3f) + 1;
+      }
+      memcpy(index[(px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64], px, 4);
+    }
+    Uint32 argb = pxFromRGBA(px[0], px[1], px[2], px[3]);
+    for (; run > 0 && i < n; run--) img->px[i++] = argb;
+  }
+  return img;
+}
+
+// decode an image file, the format is detected by its content
+static Image *imageLoadUncached(const char *path) {
+  size_t size = 0;
+  const Uint8 *data = port_mapFile(path, &size);
+  assertWithMsg(data != NULL, "cannot find or open the image");
+  Image *img = NULL;
+  if (size >= 2 && data[0] == 'P' && data[1] == '6') {
+    img = port_decodePPM(data, size);
+  } else if (size >= 2 && data[0] == 'B' && data[1] == 'M') {
+    img = port_decodeBMP(data, size);
+  } else if (size >= 4 && memcmp(data, "qoif", 4) == 0) {
+    img = port_decodeQOI(data, size);
+  }
+  port_unmapFile(data, size);
+  assertWithMsg(img != NULL, "unsupported image format (PPM/BMP/QOI only)");
+  return img;
+}
+
+// decoded images by path
+typedef struct ImageCacheEntry {
+  Uint64 hash;            // hashStr(path)
+  char *path;
+  Image *img;
+} ImageCacheEntry;
+
+static ImageCacheEntry *imageCache; // dynamic array
+
+// decode an image file once, later calls with the same path return the same
+// image (owned by the cache, don't free it)
+static const Image *imageLoad(const char *path) {
+  Uint64 hash = hashStr(path);
+  for (ImageCacheEntry *e = imageCache; e != bufEnd(imageCache); e++) {
+    if (e->hash == hash && strcmp(e->path, path) == 0) return e->img;
+  }
+  Image *img = imageLoadUncached(path);
+  char *copy = (char *)malloc(strlen(path) + 1);
+  assertWithMsg(copy != NULL, "failed to allocate memory for image cache");
+  strcpy(copy, path);
+  bufPush(imageCache, (ImageCacheEntry){hash, copy, img});
+  return img;
+}
+
+// free all cached images
+static void imageCacheClear() {
+  for (ImageCacheEntry *e = imageCache; e != bufEnd(imageCache); e++) {
+    free(e->path);
+    imageFree(e->img);
+  }
+  bufFree(imageCache);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// DIRECT PIXEL ACCESS ///////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+// Inlinable pixel access for tight loops: take a Canvas (a snapshot of the
+// vbuffer geometry) once, then put/get pixels through it with no indirect
+// calls and no reloads of the global `win`.
+// [!] no bounds checking, use pxInside() where coordinates may be off screen
+// [!] a canvas goes stale once the vbuffer changes (setLogicalSize, resize)
+
+typedef struct Canvas {
+  Uint32 *px;             // first pixel
+  int w, h;               // width/height in pixels
+  size_t stride;          // pixels per row
+} Canvas;
+
+static inline Canvas canvasFromWindow() {
+  return (Canvas){(Uint32 *)win->vbuf, win->vbufw, win->vbufh, (size_t)win->vbufw};
+}
+
+static inline bool pxInside(Canvas c, int x, int y) {
+  return (unsigned int)x < (unsigned int)c.w && (unsigned int)y < (unsigned int)c.h;
+}
+
+static inline Uint32 *pxRow(Canvas c, int y) {
+  return c.px + c.stride * y;
+}
+
+static inline void pxPut(Canvas c, int x, int y, Uint32 px) {
+  c.px[c.stride * y + x] = px;
+}
+
+static inline Uint32 pxGet(Canvas c, int x, int y) {
+  return c.px[c.stride * y + x];
+}
+
+// fill N pixels of row Y starting at X
+static inline void pxSpan(Canvas c, int x, int y, int n, Uint32 px) {
+  memSet32(pxRow(c, y) + x, px, n);
+}
+
+// Fixed-size canvas: dimensions are compile-time constants, so offsets fold
+// into shifts for power of two widths and loops over rows/columns can be
+// fully unrolled. defineCanvas(Screen, 256, 144) gives:
+//   ScreenW, ScreenH                      constants
+//   Uint32 *ScreenBind()                  vbuffer, asserts its size matches
+//   ScreenRow(px, y), ScreenPut(px, x, y, c), ScreenGet(px, x, y),
+//   ScreenSpan(px, x, y, n, c)            the same as the px* ones above
+#define defineCanvas(name, width, height) \
+  enum { name##W = (width), name##H = (height) }; \
+  static inline Uint32 *name##Bind() { \
+    assertWithMsg(win->vbufw == (width) && win->vbufh == (height), \
+      "vbuffer size doesn't match the fixed canvas " #name); \
+    return (Uint32 *)win->vbuf; \
+  } \
+  static inline Uint32 *name##Row(Uint32 *px, int y) { \
+    return px + (size_t)y * (width); \
+  } \
+  static inline void name##Put(Uint32 *px, int x, int y, Uint32 c) { \
+    px[(size_t)y * (width) + x] = c; \
+  } \
+  static inline Uint32 name##Get(const Uint32 *px, int x, int y) { \
+    return px[(size_t)y * (width) + x]; \
+  } \
+  static inline void name##Span(Uint32 *px, int x, int y, int n, Uint32 c) { \
+    Uint32 *dst = name##Row(px, y) + x; \
+    for (int i = 0; i < n; i++) dst[i] = c; \
+  }
+
 //////////////////////////////////////////////////////////////////////////////
 // DRAWING ///////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
@@ -417,17 +1031,9 @@ static void port_drawLine(int x1, int y1, int x2, int y2) {
 
 }
 
-// #define setPxRaw(win, x, y, px) \
-//   // calculate offset (location)
-//   unsigned int offs = (win)->vbufw * (y) + (x); \
-//   // fill px with drawColor
-//   *((Uint32 *)(win)->vbuf + offs) = (px); \
-
 static void port_drawPx(int x, int y) {
-  // locate px
-  unsigned int offs = win->vbufw * y + x;
   // fill px with drawColor
-  *((Uint32 *)win->vbuf + offs) = win->drawColor;
+  pxPut(canvasFromWindow(), x, y, win->drawColor);
   // render px
   win->update();
 
@@ -439,14 +1045,1011 @@ static void port_drawPx(int x, int y) {
 }
 
 static void port_drawPxRaw(int x, int y, Uint32 px) {
-  // locate px
-  unsigned int offs = win->vbufw * y + x;
-  // fill px with drawColor
-  *((Uint32 *)win->vbuf + offs) = px;
+  pxPut(canvasFromWindow(), x, y, px);
   // render px
   win->update();
 }
 
+// plot N points at once (colors == NULL means drawColor for every point)
+// [!] unlike drawPx(), doesn't render the result, call update() afterwards
+static void port_drawPixels(const SDL_Point *points, const Uint32 *colors, size_t n) {
+  Uint32 *vbuf = (Uint32 *)win->vbuf; // keep hot values out of the loop
+  unsigned int w = win->vbufw;
+  unsigned int h = win->vbufh;
+  Uint32 color = win->drawColor;
+  for (size_t i = 0; i < n; i++) {
+    // negative coordinates wrap to huge unsigned ones and get culled too
+    unsigned int x = points[i].x;
+    unsigned int y = points[i].y;
+    if (x >= w || y >= h) continue;
+    vbuf[(size_t)w * y + x] = colors ? colors[i] : color;
+  }
+}
+
+// copy an image into the logical vbuffer at (x, y), clipped to its bounds
+// [!] doesn't render the result, call update() afterwards
+static void port_drawImage(const Image *img, int x, int y) {
+  int x0 = max(x, 0), x1 = min(x + img->w, win->vbufw);
+  int y0 = max(y, 0), y1 = min(y + img->h, win->vbufh);
+  if (x0 >= x1 || y0 >= y1) return;
+  Uint32 *vbuf = (Uint32 *)win->vbuf;
+  for (int row = y0; row < y1; row++) {
+    memcpy(vbuf + (size_t)row * win->vbufw + x0,
+      img->px + (size_t)(row - y) * img->w + (x0 - x), (size_t)(x1 - x0) * 4);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// PARTICLES /////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+// Particles are kept as structure-of-arrays: each attribute is a separate
+// tightly packed array, so integration walks x/y/vx/vy as parallel streams
+// 4 particles at a time (SSE2).
+
+typedef struct Particles {
+  float *x, *y;           // positions in logical pixels
+  float *vx, *vy;         // velocities in logical pixels per second
+  Uint32 *color;          // ARGB colors
+  size_t len;             // number of alive particles
+  size_t cap;             // maximum number of particles (fixed upon creation)
+} Particles;
+
+static Particles *particlesNew(size_t cap) {
+  Particles *p = (Particles *)calloc(1, sizeof(Particles));
+  assertWithMsg(p != NULL, "failed to allocate memory for particles");
+  p->cap = cap;
+  p->x = (float *)malloc(cap * sizeof(float));
+  p->y = (float *)malloc(cap * sizeof(float));
+  p->vx = (float *)malloc(cap * sizeof(float));
+  p->vy = (float *)malloc(cap * sizeof(float));
+  p->color = (Uint32 *)malloc(cap * sizeof(Uint32));
+  assertWithMsg(p->x && p->y && p->vx && p->vy && p->color,
+    "failed to allocate memory for particles");
+  return p;
+}
+
+static void particlesFree(Particles *p) {
+  if (p == NULL) return;
+  free(p->x);
+  free(p->y);
+  free(p->vx);
+  free(p->vy);
+  free(p->color);
+  free(p);
+}
+
+// spawn a particle, returns its index
+static size_t particlesAdd(Particles *p, float x, float y,
+  float vx, float vy, Uint32 color) {
+  assertWithMsg(p->len < p->cap, "particles capacity is exceeded");
+  size_t i = p->len++;
+  p->x[i] = x;
+  p->y[i] = y;
+  p->vx[i] = vx;
+  p->vy[i] = vy;
+  p->color[i] = color;
+  return i;
+}
+
+// remove a particle by moving the last one in its place (order isn't kept)
+static void particlesRemove(Particles *p, size_t i) {
+  assert(i < p->len);
+  size_t last = --p->len;
+  p->x[i] = p->x[last];
+  p->y[i] = p->y[last];
+  p->vx[i] = p->vx[last];
+  p->vy[i] = p->vy[last];
+  p->color[i] = p->color[last];
+}
+
+PORT_EXACT_FP_BEGIN
+
+// advance particles FROM.. onwards by DT seconds under constant acceleration
+// (AX, AY) (scalar reference version)
+static void port_particlesStepScalar(Particles *p, size_t from,
+  float dt, float ax, float ay) {
+  float *x = p->x, *y = p->y, *vx = p->vx, *vy = p->vy;
+  float dvx = ax * dt;
+  float dvy = ay * dt;
+  for (size_t i = from; i < p->len; i++) {
+    vx[i] += dvx;
+    vy[i] += dvy;
+    x[i] += vx[i] * dt;
+    y[i] += vy[i] * dt;
+  }
+}
+
+// advance all particles by DT seconds under constant acceleration (AX, AY)
+// (semi-implicit Euler: velocity first, then position)
+static void particlesStep(Particles *p, float dt, float ax, float ay) {
+  size_t i = 0;
+  // single pass: every attribute is loaded and stored exactly once
+#ifdef PORT_SSE2
+  float *x = p->x, *y = p->y, *vx = p->vx, *vy = p->vy;
+  __m128 sdt = _mm_set1_ps(dt);
+  __m128 sdvx = _mm_set1_ps(ax * dt), sdvy = _mm_set1_ps(ay * dt);
+  for (; i + 4 <= p->len; i += 4) {
+    __m128 u = _mm_add_ps(_mm_loadu_ps(vx + i), sdvx);
+    __m128 v = _mm_add_ps(_mm_loadu_ps(vy + i), sdvy);
+    _mm_storeu_ps(vx + i, u);
+    _mm_storeu_ps(vy + i, v);
+    _mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), _mm_mul_ps(u, sdt)));
+    _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(v, sdt)));
+  }
+#endif
+  port_particlesStepScalar(p, i, dt, ax, ay); // the tail
+}
+
+PORT_EXACT_FP_END
+
+// plot all particles into the logical vbuffer, skipping those out of bounds
+// [!] doesn't render the result, call update() afterwards
+static void particlesDraw(const Particles *p) {
+  const float *x = p->x;
+  const float *y = p->y;
+  const Uint32 *color = p->color;
+  Uint32 *vbuf = (Uint32 *)win->vbuf;
+  float w = (float)win->vbufw;
+  float h = (float)win->vbufh;
+  size_t stride = win->vbufw;
+  for (size_t i = 0; i < p->len; i++) {
+    // compare as floats first: truncation alone would fold (-1, 0) into 0
+    if (!(x[i] >= 0.0f && x[i] < w && y[i] >= 0.0f && y[i] < h)) continue;
+    vbuf[stride * (size_t)y[i] + (size_t)x[i]] = color[i];
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// TILEMAP ///////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+// The tile layer is drawn straight into the logical vbuffer, which is treated
+// as a ring: world pixel (x, y) always lives at vbuffer pixel
+// (x mod vbufw, y mod vbufh). Scrolling then only moves the scroll registers
+// and redraws the strips that became exposed, the same way old hardware did.
+// [!] while a tilemap is scrolled, vbuffer coordinates are ring coordinates,
+//     so anything else drawn on top must add the scroll offset itself.
+
+typedef struct Tileset {
+  Uint32 *px;             // tiles one after another, each row of a tile is
+                          // contiguous (tilew * tileh ARGB pixels per tile)
+  int tilew, tileh;       // tile width/height in pixels
+  int count;              // number of tiles
+} Tileset;
+
+typedef struct Tilemap {
+  Tileset *set;
+  Uint16 *map;            // tile indices, row by row (repeats beyond edges)
+  int mapw, maph;         // map width/height in tiles
+  int x, y;               // world position of the top-left visible pixel
+
+  // ring state
+  char *ring;             // vbuffer the layer was drawn into
+  int ringw, ringh;       // its width/height at the time
+} Tilemap;
+
+// slice an ARGB atlas (row by row, left to right) into tiles
+static Tileset *tilesetNew(const Uint32 *atlas, int atlasw, int atlash,
+  int tilew, int tileh) {
+  assertWithMsg(tilew > 0 && tileh > 0 && atlasw >= tilew && atlash >= tileh,
+    "atlas must fit at least one tile");
+  Tileset *ts = (Tileset *)malloc(sizeof(Tileset));
+  assertWithMsg(ts != NULL, "failed to allocate memory for tileset");
+  int cols = atlasw / tilew;
+  int rows = atlash / tileh;
+  ts->tilew = tilew;
+  ts->tileh = tileh;
+  ts->count = cols * rows;
+  ts->px = (Uint32 *)malloc((size_t)ts->count * tilew * tileh * 4);
+  assertWithMsg(ts->px != NULL, "failed to allocate memory for tiles");
+
+  Uint32 *dst = ts->px;
+  for (int ty = 0; ty < rows; ty++) {
+    for (int tx = 0; tx < cols; tx++) {
+      const Uint32 *src = atlas + (size_t)ty * tileh * atlasw + tx * tilew;
+      for (int y = 0; y < tileh; y++) {
+        memcpy(dst, src + (size_t)y * atlasw, (size_t)tilew * 4);
+        dst += tilew;
+      }
+    }
+  }
+  return ts;
+}
+
+static void tilesetFree(Tileset *ts) {
+  if (ts == NULL) return;
+  free(ts->px);
+  free(ts);
+}
+
+static Tilemap *tilemapNew(Tileset *set, int mapw, int maph) {
+  assertWithMsg(mapw > 0 && maph > 0, "tilemap size cannot be 0");
+  Tilemap *tm = (Tilemap *)calloc(1, sizeof(Tilemap));
+  assertWithMsg(tm != NULL, "failed to allocate memory for tilemap");
+  tm->set = set;
+  tm->mapw = mapw;
+  tm->maph = maph;
+  tm->map = (Uint16 *)calloc((size_t)mapw * maph, sizeof(Uint16));
+  assertWithMsg(tm->map != NULL, "failed to allocate memory for tile indices");
+  return tm;
+}
+
+static void tilemapFree(Tilemap *tm) {
+  if (tm == NULL) return;
+  free(tm->map);
+  free(tm);
+}
+
+// draw world rectangle (wx, wy, w, h) into the ring, w/h <= vbuffer size
+static void port_tilemapFill(Tilemap *tm, int wx, int wy, int w, int h) {
+  const Tileset *ts = tm->set;
+  Uint32 *ring = (Uint32 *)tm->ring;
+  int ringw = tm->ringw, ringh = tm->ringh;
+
+  for (int y = wy; y < wy + h; y++) {
+    int ty = modWrap(y, ts->tileh * tm->maph) / ts->tileh; // tile row in map
+    int iny = modWrap(y, ts->tileh);                       // px row in tile
+    const Uint16 *maprow = tm->map + (size_t)ty * tm->mapw;
+    Uint32 *dst = ring + (size_t)modWrap(y, ringh) * ringw;
+
+    // copy the row span by span, each span ends either at a tile or ring edge
+    int left = w;
+    int rx = modWrap(wx, ringw);
+    int mx = modWrap(wx, ts->tilew * tm->mapw);
+    while (left > 0) {
+      int tx = mx / ts->tilew;
+      int inx = mx - tx * ts->tilew;
+      int n = min(min(ts->tilew - inx, ringw - rx), left);
+      const Uint32 *tile = ts->px + (size_t)maprow[tx] * ts->tilew * ts->tileh;
+      memcpy(dst + rx, tile + iny * ts->tilew + inx, (size_t)n * 4);
+      left -= n;
+      rx += n;
+      if (rx == ringw) rx = 0;
+      mx += n;
+      if (mx == ts->tilew * tm->mapw) mx = 0;
+    }
+  }
+}
+
+// (re)draw the whole visible area and load the scroll registers
+static void tilemapDraw(Tilemap *tm) {
+  tm->ring = win->vbuf;
+  tm->ringw = win->vbufw;
+  tm->ringh = win->vbufh;
+  port_tilemapFill(tm, tm->x, tm->y, tm->ringw, tm->ringh);
+  win->setScroll(modWrap(tm->x, tm->ringw), modWrap(tm->y, tm->ringh));
+}
+
+// scroll the layer by (dx, dy) pixels redrawing only the exposed edges
+static void tilemapScroll(Tilemap *tm, int dx, int dy) {
+  int ox = tm->x, oy = tm->y;
+  tm->x += dx;
+  tm->y += dy;
+
+  // the ring is stale if the vbuffer was reallocated or resized meanwhile
+  bool stale = tm->ring != win->vbuf ||
+    tm->ringw != win->vbufw || tm->ringh != win->vbufh;
+  if (stale || abs(dx) >= tm->ringw || abs(dy) >= tm->ringh) {
+    tilemapDraw(tm);
+    return;
+  }
+
+  // exposed columns (for all new rows), then exposed rows (full width)
+  int w = tm->ringw, h = tm->ringh;
+  if (dx > 0) port_tilemapFill(tm, ox + w, tm->y, dx, h);
+  if (dx < 0) port_tilemapFill(tm, tm->x, tm->y, -dx, h);
+  if (dy > 0) port_tilemapFill(tm, tm->x, oy + h, w, dy);
+  if (dy < 0) port_tilemapFill(tm, tm->x, tm->y, w, -dy);
+  win->setScroll(modWrap(tm->x, w), modWrap(tm->y, h));
+}
+
+// change a tile, redrawing it right away if it's (partially) visible
+static void tilemapSet(Tilemap *tm, int tx, int ty, Uint16 idx) {
+  assertWithMsg(tx >= 0 && tx < tm->mapw && ty >= 0 && ty < tm->maph,
+    "tile is out of the map");
+  assertWithMsg(idx < tm->set->count, "tile index is out of the tileset");
+  tm->map[(size_t)ty * tm->mapw + tx] = idx;
+  if (tm->ring != win->vbuf) return; // not drawn yet, nothing to update
+
+  // the map repeats, so every visible copy of the tile has to be redrawn
+  int tw = tm->set->tilew, th = tm->set->tileh;
+  int periodx = tw * tm->mapw, periody = th * tm->maph;
+  // first copies that end past the viewport's top-left corner
+  int firstx = tm->x + modWrap(tx * tw - tm->x, periodx) - periodx;
+  int firsty = tm->y + modWrap(ty * th - tm->y, periody) - periody;
+  for (int py = firsty; py < tm->y + tm->ringh; py += periody) {
+    for (int px = firstx; px < tm->x + tm->ringw; px += periodx) {
+      int x0 = max(px, tm->x), x1 = min(px + tw, tm->x + tm->ringw);
+      int y0 = max(py, tm->y), y1 = min(py + th, tm->y + tm->ringh);
+      if (x0 < x1 && y0 < y1) port_tilemapFill(tm, x0, y0, x1 - x0, y1 - y0);
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// 3D PIPELINE ///////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+// A tiny software 3D path on top of the logical vbuffer:
+// vertices -> clip space (mvp) -> near/guard-band clipping -> perspective
+// divide -> backface culling -> half-space rasterization in 8x8 blocks with
+// per-block early depth reject -> depth tested pixels.
+// Conventions follow OpenGL: column-major matrices, counter-clockwise front
+// faces, clip volume -w <= z <= w. Depth is stored as 0 (near) .. 1 (far).
+
+typedef struct Vec4 {
+  float x, y, z, w;
+} Vec4;
+
+typedef struct Mat4 {
+  float m[16];            // column-major, m[col * 4 + row]
+} Mat4;
+
+typedef struct Mesh {
+  float *pos;             // vertex positions, x y z per vertex
+  Uint32 *colors;         // ARGB color per vertex (NULL means drawColor)
+  int *idx;               // vertex indices, 3 per triangle
+  int nverts, ntris;
+} Mesh;
+
+// drawMesh() flags
+#define shadeFLAT     (0)      // whole triangle gets its first vertex color
+#define shadeGOURAUD  (1)      // vertex colors are interpolated
+#define cullNONE      (1 << 1) // draw back faces as well
+
+static Mat4 mat4Identity() {
+  return (Mat4){{1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1}};
+}
+
+static Mat4 mat4Translate(float x, float y, float z) {
+  Mat4 r = mat4Identity();
+  r.m[12] = x;
+  r.m[13] = y;
+  r.m[14] = z;
+  return r;
+}
+
+static Mat4 mat4Scale(float x, float y, float z) {
+  Mat4 r = mat4Identity();
+  r.m[0] = x;
+  r.m[5] = y;
+  r.m[10] = z;
+  return r;
+}
+
+static Mat4 mat4RotateX(float rad) {
+  Mat4 r = mat4Identity();
+  float c = cosf(rad), s = sinf(rad);
+  r.m[5] = c; r.m[6] = s;
+  r.m[9] = -s; r.m[10] = c;
+  return r;
+}
+
+static Mat4 mat4RotateY(float rad) {
+  Mat4 r = mat4Identity();
+  float c = cosf(rad), s = sinf(rad);
+  r.m[0] = c; r.m[2] = -s;
+  r.m[8] = s; r.m[10] = c;
+  return r;
+}
+
+static Mat4 mat4RotateZ(float rad) {
+  Mat4 r = mat4Identity();
+  float c = cosf(rad), s = sinf(rad);
+  r.m[0] = c; r.m[1] = s;
+  r.m[4] = -s; r.m[5] = c;
+  return r;
+}
+
+// FOVY in radians, NEAR/FAR are positive distances along -z
+static Mat4 mat4Perspective(float fovy, float aspect, float near, float far) {
+  float f = 1.0f / tanf(fovy / 2);
+  Mat4 r = {{0}};
+  r.m[0] = f / aspect;
+  r.m[5] = f;
+  r.m[10] = (far + near) / (near - far);
+  r.m[11] = -1;
+  r.m[14] = 2 * far * near / (near - far);
+  return r;
+}
+
+// vector kernels below must match their scalar references bit for bit
+// (see verifyKernels()), compilers would fuse the scalar ones into FMAs on
+// FMA targets (-mfma, -march=native)
+PORT_EXACT_FP_BEGIN
+
+// transform N points (x y z, w = 1) by matrix M (scalar reference version)
+static void port_transformScalar(const Mat4 *m, const float *xyz,
+  Vec4 *out, size_t n) {
+  const float *a = m->m;
+  for (size_t i = 0; i < n; i++, xyz += 3) {
+    float x = xyz[0], y = xyz[1], z = xyz[2];
+    out[i].x = a[0] * x + a[4] * y + a[8]  * z + a[12];
+    out[i].y = a[1] * x + a[5] * y + a[9]  * z + a[13];
+    out[i].z = a[2] * x + a[6] * y + a[10] * z + a[14];
+    out[i].w = a[3] * x + a[7] * y + a[11] * z + a[15];
+  }
+}
+
+#ifdef PORT_SSE2
+// the same, one whole output vertex per SSE register
+static void port_transformSSE(const Mat4 *m, const float *xyz,
+  Vec4 *out, size_t n) {
+  __m128 c0 = _mm_loadu_ps(m->m);
+  __m128 c1 = _mm_loadu_ps(m->m + 4);
+  __m128 c2 = _mm_loadu_ps(m->m + 8);
+  __m128 c3 = _mm_loadu_ps(m->m + 12);
+  for (size_t i = 0; i < n; i++, xyz += 3) {
+    // same order of operations as the scalar version (bit-exact results,
+    // given no contraction, see above)
+    __m128 r = _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(xyz[0])),
+                          _mm_mul_ps(c1, _mm_set1_ps(xyz[1])));
+    r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(xyz[2])));
+    r = _mm_add_ps(r, c3);
+    _mm_storeu_ps(&out[i].x, r);
+  }
+}
+#endif
+
+// transform N points (x y z triples) into homogeneous clip space
+static void transformVertices(const Mat4 *m, const float *xyz,
+  Vec4 *out, size_t n) {
+#ifdef PORT_SSE2
+  port_transformSSE(m, xyz, out, n);
+#else
+  port_transformScalar(m, xyz, out, n);
+#endif
+}
+
+// A * B (scalar reference version)
+static Mat4 port_mat4MulScalar(const Mat4 *a, const Mat4 *b) {
+  Mat4 r;
+  for (int c = 0; c < 4; c++) {
+    for (int row = 0; row < 4; row++) {
+      float sum = a->m[row] * b->m[c * 4];
+      for (int k = 1; k < 4; k++) sum += a->m[k * 4 + row] * b->m[c * 4 + k];
+      r.m[c * 4 + row] = sum;
+    }
+  }
+  return r;
+}
+
+// A * B (B is applied first)
+static Mat4 mat4Mul(const Mat4 *a, const Mat4 *b) {
+#ifdef PORT_SSE2
+  Mat4 r;
+  // each column of B is a point transformed by A
+  for (int c = 0; c < 4; c++) {
+    __m128 col = _mm_mul_ps(_mm_loadu_ps(a->m), _mm_set1_ps(b->m[c * 4]));
+    for (int k = 1; k < 4; k++) {
+      col = _mm_add_ps(col,
+        _mm_mul_ps(_mm_loadu_ps(a->m + k * 4), _mm_set1_ps(b->m[c * 4 + k])));
+    }
+    _mm_storeu_ps(r.m + c * 4, col);
+  }
+  return r;
+#else
+  return port_mat4MulScalar(a, b);
+#endif
+}
+
+PORT_EXACT_FP_END
+
+static Mesh *meshNew(int nverts, int ntris) {
+  Mesh *m = (Mesh *)calloc(1, sizeof(Mesh));
+  assertWithMsg(m != NULL, "failed to allocate memory for mesh");
+  m->nverts = nverts;
+  m->ntris = ntris;
+  m->pos = (float *)calloc((size_t)nverts * 3, sizeof(float));
+  m->colors = (Uint32 *)calloc((size_t)nverts, sizeof(Uint32));
+  m->idx = (int *)calloc((size_t)ntris * 3, sizeof(int));
+  assertWithMsg(m->pos && m->colors && m->idx, "failed to allocate memory for mesh");
+  return m;
+}
+
+static void meshFree(Mesh *m) {
+  if (m == NULL) return;
+  free(m->pos);
+  free(m->colors);
+  free(m->idx);
+  free(m);
+}
+
+// make room for a W x H depth buffer, it's reallocated only to grow
+static void port_depthReserve(int w, int h) {
+  size_t n = (size_t)w * h, nb = (size_t)((w + 7) / 8) * ((h + 7) / 8);
+  if (win->zbuf != NULL && n <= win->zbufCap && nb <= win->zmaxCap) return;
+  free(win->zbuf);
+  free(win->zmax);
+  win->zbuf = (float *)malloc(n * sizeof(float));
+  win->zmax = (float *)malloc(nb * sizeof(float));
+  assertWithMsg(win->zbuf != NULL && win->zmax != NULL,
+    "failed to allocate memory for depth buffer");
+  win->zbufCap = n;
+  win->zmaxCap = nb;
+}
+
+// make sure the depth buffer matches the vbuffer and reset it to far
+static void depthClear() {
+  int w = win->vbufw, h = win->vbufh;
+  int bw = (w + 7) / 8, bh = (h + 7) / 8;
+  port_depthReserve(w, h);
+  win->zbufw = w;
+  win->zbufh = h;
+  for (size_t i = 0; i < (size_t)w * h; i++) win->zbuf[i] = 1.0f;
+  for (size_t i = 0; i < (size_t)bw * bh; i++) win->zmax[i] = 1.0f;
+}
+
+// clip space vertex with its color channels (for interpolation)
+typedef struct ClipVert {
+  float x, y, z, w;
+  float r, g, b;
+} ClipVert;
+
+// screen space vertex, x/y in 28.4 fixed point
+typedef struct RasterVert {
+  Sint64 x, y;
+  float z;
+  float r, g, b;
+} RasterVert;
+
+// linear attribute across the triangle: a(x, y) = a0 + dx * x + dy * y
+typedef struct Plane {
+  float a0, dx, dy;
+} Plane;
+
+static Plane port_planeFrom(const RasterVert *v, float a0, float a1, float a2,
+  float area) {
+  float x0 = v[0].x / 16.0f, y0 = v[0].y / 16.0f;
+  float x1 = v[1].x / 16.0f - x0, y1 = v[1].y / 16.0f - y0;
+  float x2 = v[2].x / 16.0f - x0, y2 = v[2].y / 16.0f - y0;
+  Plane p;
+  p.dx = ((a1 - a0) * y2 - (a2 - a0) * y1) / area;
+  p.dy = ((a2 - a0) * x1 - (a1 - a0) * x2) / area;
+  p.a0 = a0 - p.dx * x0 - p.dy * y0;
+  return p;
+}
+
+#define port_planeAt(p, px, py) ((p).a0 + (p).dx * (px) + (p).dy * (py))
+
+// rasterize a screen space triangle with depth testing
+static void port_rasterTriangle(RasterVert *v, int flags, Uint32 flat) {
+  // twice the signed area; front faces come out negative as y points down
+  Sint64 area2 = (v[1].x - v[0].x) * (v[2].y - v[0].y) -
+                 (v[1].y - v[0].y) * (v[2].x - v[0].x);
+  if (area2 == 0) return;
+  if (area2 > 0 && !(flags & cullNONE)) return; // back face
+  if (area2 < 0) { // make the winding positive for the edge functions below
+    RasterVert t = v[1]; v[1] = v[2]; v[2] = t;
+    area2 = -area2;
+  }
+
+  int w = win->vbufw, h = win->vbufh;
+  // pixel bounding box clamped to the screen, aligned down to 8x8 blocks
+  Sint64 minX = min(v[0].x, min(v[1].x, v[2].x));
+  Sint64 maxX = max(v[0].x, max(v[1].x, v[2].x));
+  Sint64 minY = min(v[0].y, min(v[1].y, v[2].y));
+  Sint64 maxY = max(v[0].y, max(v[1].y, v[2].y));
+  int xmin = (int)max(0, minX >> 4), x0 = xmin & ~7;
+  int ymin = (int)max(0, minY >> 4), y0 = ymin & ~7;
+  int x1 = (int)min(w - 1, maxX >> 4);
+  int y1 = (int)min(h - 1, maxY >> 4);
+  if (x0 > x1 || y0 > y1) return;
+
+  // edge functions E(P) = dx * (Py - Ay) - dy * (Px - Ax), inside if >= 0
+  Sint64 e[3], stepx[3], stepy[3];
+  for (int i = 0; i < 3; i++) {
+    const RasterVert *a = &v[i], *b = &v[(i + 1) % 3];
+    Sint64 dx = b->x - a->x, dy = b->y - a->y;
+    // top-left fill rule: pixels exactly on right/bottom edges are left out
+    bool topLeft = dy < 0 || (dy == 0 && dx > 0);
+    // evaluated at the center of pixel (x0, y0)
+    Sint64 px = (Sint64)x0 * 16 + 8, py = (Sint64)y0 * 16 + 8;
+    e[i] = dx * (py - a->y) - dy * (px - a->x) - (topLeft ? 0 : 1);
+    stepx[i] = -dy * 16;
+    stepy[i] = dx * 16;
+  }
+
+  // attribute planes (in pixel units, sampled at pixel centers)
+  float area = area2 / 256.0f;
+  Plane pz = port_planeFrom(v, v[0].z, v[1].z, v[2].z, area);
+  float zmin = min(v[0].z, min(v[1].z, v[2].z));
+  bool gouraud = flags & shadeGOURAUD;
+  Plane pr, pg, pb;
+  if (gouraud) {
+    pr = port_planeFrom(v, v[0].r, v[1].r, v[2].r, area);
+    pg = port_planeFrom(v, v[0].g, v[1].g, v[2].g, area);
+    pb = port_planeFrom(v, v[0].b, v[1].b, v[2].b, area);
+  }
+
+  Uint32 *vbuf = (Uint32 *)win->vbuf;
+  float *zbuf = win->zbuf;
+  int zbw = (w + 7) / 8;
+
+  for (int by = y0; by <= y1; by += 8) {
+    for (int bx = x0; bx <= x1; bx += 8) {
+      // edge values at the top-left pixel of the block
+      Sint64 eb[3];
+      bool full = true, out = false;
+      for (int i = 0; i < 3; i++) {
+        eb[i] = e[i] + stepx[i] * ((bx - x0)) + stepy[i] * ((by - y0));
+        // extremes over the block are at its corners (E is linear)
+        Sint64 c1 = eb[i] + stepx[i] * 7, c2 = eb[i] + stepy[i] * 7;
+        Sint64 c3 = c1 + stepy[i] * 7;
+        Sint64 lo = min(min(eb[i], c1), min(c2, c3));
+        Sint64 hi = max(max(eb[i], c1), max(c2, c3));
+        if (hi < 0) out = true;
+        if (lo < 0) full = false;
+      }
+      if (out) continue;
+
+      // hierarchical depth: skip the block if the triangle can't be nearer
+      // than the farthest pixel already there
+      float *bzmax = &win->zmax[(by / 8) * zbw + bx / 8];
+      float cx0 = bx + 0.5f, cy0 = by + 0.5f;
+      float zc = min(min(port_planeAt(pz, cx0, cy0), port_planeAt(pz, cx0 + 7, cy0)),
+                     min(port_planeAt(pz, cx0, cy0 + 7), port_planeAt(pz, cx0 + 7, cy0 + 7)));
+      if (max(zc, zmin) >= *bzmax) continue;
+
+      // walk only the part of the block inside the bounding box
+      int xs = max(bx, xmin), xend = min(bx + 8, x1 + 1);
+      int ys = max(by, ymin), yend = min(by + 8, y1 + 1);
+      for (int i = 0; i < 3; i++) eb[i] += stepx[i] * (xs - bx) + stepy[i] * (ys - by);
+      bool written = false;
+      for (int y = ys; y < yend; y++) {
+        Sint64 e0 = eb[0], e1 = eb[1], e2 = eb[2];
+        float py = y + 0.5f;
+        float z = port_planeAt(pz, xs + 0.5f, py);
+        Uint32 *prow = vbuf + (size_t)y * w;
+        float *zrow = zbuf + (size_t)y * w;
+        for (int x = xs; x < xend; x++) {
+          if ((full || (e0 | e1 | e2) >= 0) && z < zrow[x]) {
+            zrow[x] = z;
+            if (gouraud) {
+              float px = x + 0.5f;
+              int r = (int)port_planeAt(pr, px, py);
+              int g = (int)port_planeAt(pg, px, py);
+              int b = (int)port_planeAt(pb, px, py);
+              prow[x] = pxFromRGBA(min(max(r, 0), 255), min(max(g, 0), 255),
+                                   min(max(b, 0), 255), 255);
+            } else {
+              prow[x] = flat;
+            }
+            written = true;
+          }
+          e0 += stepx[0];
+          e1 += stepx[1];
+          e2 += stepx[2];
+          z += pz.dx;
+        }
+        eb[0] += stepy[0];
+        eb[1] += stepy[1];
+        eb[2] += stepy[2];
+      }
+
+      // depths only ever decrease, so the old block maximum stays a valid
+      // (conservative) bound; it's worth tightening once the block is covered
+      if (written && full) {
+        float zfar = 0;
+        for (int y = by; y < min(by + 8, h); y++) {
+          for (int x = bx; x < min(bx + 8, w); x++) zfar = max(zfar, zbuf[(size_t)y * w + x]);
+        }
+        *bzmax = zfar;
+      }
+    }
+  }
+}
+
+// signed distances to the clipping planes (inside if >= 0): near plane and a
+// guard band far enough beyond the screen to keep fixed point coordinates sane
+#define port_clipGUARD (8.0f)
+static float port_clipDist(const ClipVert *v, int plane) {
+  switch (plane) {
+    case 0: return v->z + v->w;
+    case 1: return port_clipGUARD * v->w + v->x;
+    case 2: return port_clipGUARD * v->w - v->x;
+    case 3: return port_clipGUARD * v->w + v->y;
+    default: return port_clipGUARD * v->w - v->y;
+  }
+}
+
+// perspective divide and viewport mapping, then rasterize
+static void port_drawClipTriangle(const ClipVert *c, int flags, Uint32 flat) {
+  RasterVert v[3];
+  float w = (float)win->vbufw, h = (float)win->vbufh;
+  for (int i = 0; i < 3; i++) {
+    float iw = 1.0f / c[i].w;
+    v[i].x = lrintf((c[i].x * iw * 0.5f + 0.5f) * w * 16);
+    v[i].y = lrintf((0.5f - c[i].y * iw * 0.5f) * h * 16);
+    v[i].z = c[i].z * iw * 0.5f + 0.5f;
+    v[i].r = c[i].r;
+    v[i].g = c[i].g;
+    v[i].b = c[i].b;
+  }
+  port_rasterTriangle(v, flags, flat);
+}
+
+// clip a triangle against near plane and guard band (Sutherland-Hodgman)
+static void port_clipTriangle(const ClipVert *tri, int flags, Uint32 flat) {
+  ClipVert bufa[9], bufb[9];
+  ClipVert *in = bufa, *out = bufb;
+  int n = 3;
+  for (int i = 0; i < 3; i++) in[i] = tri[i];
+
+  for (int plane = 0; plane < 5 && n >= 3; plane++) {
+    int m = 0;
+    for (int i = 0; i < n; i++) {
+      const ClipVert *a = &in[i], *b = &in[(i + 1) % n];
+      float da = port_clipDist(a, plane), db = port_clipDist(b, plane);
+      if (da >= 0) out[m++] = *a;
+      if ((da >= 0) != (db >= 0)) { // the edge crosses the plane
+        float t = da / (da - db);
+        out[m].x = a->x + (b->x - a->x) * t;
+        out[m].y = a->y + (b->y - a->y) * t;
+        out[m].z = a->z + (b->z - a->z) * t;
+        out[m].w = a->w + (b->w - a->w) * t;
+        out[m].r = a->r + (b->r - a->r) * t;
+        out[m].g = a->g + (b->g - a->g) * t;
+        out[m].b = a->b + (b->b - a->b) * t;
+        m++;
+      }
+    }
+    ClipVert *t = in; in = out; out = t;
+    n = m;
+  }
+
+  // triangulate the resulting convex polygon as a fan
+  for (int i = 1; i + 1 < n; i++) {
+    ClipVert fan[3] = {in[0], in[i], in[i + 1]};
+    port_drawClipTriangle(fan, flags, flat);
+  }
+}
+
+// draw a mesh transformed by MVP into the logical vbuffer
+// [!] call depthClear() once per frame before drawing, update() afterwards
+static void drawMesh(const Mesh *mesh, const Mat4 *mvp, int flags) {
+  assertWithMsg(win->zbuf != NULL && win->zbufw == win->vbufw &&
+    win->zbufh == win->vbufh, "depth buffer doesn't match vbuffer, call depthClear() first");
+
+  // transform all vertices at once into frame scratch memory
+  Vec4 *clip = (Vec4 *)frameAlloc((size_t)mesh->nverts * sizeof(Vec4));
+  transformVertices(mvp, mesh->pos, clip, mesh->nverts);
+
+  for (int t = 0; t < mesh->ntris; t++) {
+    const int *idx = mesh->idx + t * 3;
+    ClipVert tri[3];
+    int outside = 0x1f, inside = 0x1f; // and/or of per-plane outcodes
+    for (int i = 0; i < 3; i++) {
+      const Vec4 *p = &clip[idx[i]];
+      Uint32 c = mesh->colors ? mesh->colors[idx[i]] : win->drawColor;
+      tri[i] = (ClipVert){p->x, p->y, p->z, p->w, R8(c), G8(c), B8(c)};
+      // trivial reject against the view frustum itself
+      int code = (p->z < -p->w) | (p->x < -p->w) << 1 | (p->x > p->w) << 2 |
+                 (p->y < -p->w) << 3 | (p->y > p->w) << 4;
+      outside &= code;
+      // and the planes we actually clip against
+      int clipcode = 0;
+      for (int plane = 0; plane < 5; plane++) {
+        if (port_clipDist(&tri[i], plane) < 0) clipcode |= 1 << plane;
+      }
+      inside &= ~clipcode;
+    }
+    if (outside) continue; // all vertices beyond the same frustum plane
+
+    Uint32 c = mesh->colors ? mesh->colors[idx[0]] : win->drawColor;
+    Uint32 flat = pxFromRGB(c & 0xffffff);
+    if (inside == 0x1f) port_drawClipTriangle(tri, flags, flat);
+    else port_clipTriangle(tri, flags, flat);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// POST-PROCESSING ///////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+// Per-pixel effects applied while the logical vbuffer is copied onto the
+// physical one, so each output row is produced in cache and written to
+// memory once, no matter how many stages are on. Stages run in fixed order:
+//   color grading (gamma/brightness/contrast or custom LUTs)
+//   -> CRT scanlines & aperture mask -> ordered dithering
+// Every stage works on a single row, thus any band of rows can be processed
+// independently (and in parallel) with port_presentBand().
+
+typedef struct PostFx {
+  // color grading
+  bool grade;             // if LUTs below are applied
+  Uint8 lut[3][256];      // per channel (r, g, b) transfer tables
+
+  // CRT
+  int scanline;           // odd rows brightness, 0..256 (256 = off)
+  bool mask;              // RGB aperture mask (columns of R, G, B tint)
+
+  // dithering
+  int ditherBits;         // bits per channel to quantize to (0 = off)
+} PostFx;
+
+// 4x4 Bayer matrix (thresholds 0..15)
+static const Uint8 port_bayer4[4][4] = {
+  { 0,  8,  2, 10},
+  {12,  4, 14,  6},
+  { 3, 11,  1,  9},
+  {15,  7, 13,  5},
+};
+
+// aperture mask strength per channel for columns x % 3 == 0, 1, 2 (0..256)
+static const Uint16 port_apertureMask[3][3] = {
+  {256, 176, 176}, // r emphasized
+  {176, 256, 176}, // g
+  {176, 176, 256}, // b
+};
+
+static PostFx *port_postGet() {
+  if (win->post == NULL) {
+    win->post = (PostFx *)calloc(1, sizeof(PostFx));
+    assertWithMsg(win->post != NULL, "failed to allocate memory for post effects");
+    win->post->scanline = 256;
+  }
+  return win->post;
+}
+
+// color grading through custom per channel tables (NULL turns grading off)
+static void postSetLUT(const Uint8 *r, const Uint8 *g, const Uint8 *b) {
+  PostFx *fx = port_postGet();
+  fx->grade = r != NULL && g != NULL && b != NULL;
+  if (!fx->grade) return;
+  memcpy(fx->lut[0], r, 256);
+  memcpy(fx->lut[1], g, 256);
+  memcpy(fx->lut[2], b, 256);
+}
+
+// color grading: GAMMA (1 = off), BRIGHTNESS offset (-1..1, 0 = off),
+// CONTRAST around mid gray (1 = off)
+static void postSetGrading(float gamma, float brightness, float contrast) {
+  Uint8 lut[256];
+  for (int i = 0; i < 256; i++) {
+    float c = powf(i / 255.0f, 1.0f / gamma);
+    c = (c - 0.5f) * contrast + 0.5f + brightness;
+    lut[i] = (Uint8)lrintf(min(max(c, 0.0f), 1.0f) * 255);
+  }
+  postSetLUT(lut, lut, lut);
+}
+
+// CRT look: odd rows dimmed to INTENSITY (0..1, 1 = off), MASK toggles the
+// RGB aperture mask
+static void postSetCRT(float intensity, bool mask) {
+  PostFx *fx = port_postGet();
+  fx->scanline = (int)lrintf(min(max(intensity, 0.0f), 1.0f) * 256);
+  fx->mask = mask;
+}
+
+// ordered dithering down to BITS per channel (0 or 8 = off)
+static void postSetDither(int bits) {
+  assertWithMsg(bits >= 0 && bits <= 8, "dither bits must be within 0..8");
+  port_postGet()->ditherBits = bits == 8 ? 0 : bits;
+}
+
+// turn all post effects off
+static void postClear() {
+  free(win->post);
+  win->post = NULL;
+}
+
+// per channel (b, g, r, a lanes) multipliers for pixel at column X of row Y
+static void port_postFactors(const PostFx *fx, int x, int y, Uint16 f[4]) {
+  int scan = (y & 1) ? fx->scanline : 256;
+  const Uint16 *m = port_apertureMask[x % 3];
+  f[0] = (Uint16)(fx->mask ? (m[2] * scan) >> 8 : scan);
+  f[1] = (Uint16)(fx->mask ? (m[1] * scan) >> 8 : scan);
+  f[2] = (Uint16)(fx->mask ? (m[0] * scan) >> 8 : scan);
+  f[3] = 256; // alpha stays
+}
+
+// scanlines & mask (scalar reference version)
+static void port_postScaleScalar(const PostFx *fx, Uint32 *row, int n, int y) {
+  for (int x = 0; x < n; x++) {
+    Uint16 f[4];
+    port_postFactors(fx, x, y, f);
+    Uint8 *c = (Uint8 *)&row[x]; // b, g, r, a on little-endian
+    for (int i = 0; i < 4; i++) c[i] = (Uint8)((c[i] * f[i]) >> 8);
+  }
+}
+
+// ordered dithering (scalar reference version)
+static void port_postDitherScalar(const PostFx *fx, Uint32 *row, int n, int y) {
+  int q = 8 - fx->ditherBits;
+  Uint8 keep = (Uint8)(0xff << q);
+  for (int x = 0; x < n; x++) {
+    Uint8 t = (Uint8)((port_bayer4[y & 3][x & 3] << q) >> 4);
+    Uint8 *c = (Uint8 *)&row[x];
+    for (int i = 0; i < 3; i++) c[i] = (Uint8)(min(c[i] + t, 255) & keep);
+  }
+}
+
+#ifdef PORT_SSE2
+// the same, two pixels (8 channels widened to 16 bits) per multiply
+static void port_postScaleSSE2(const PostFx *fx, Uint32 *row, int n, int y) {
+  // factors repeat every 3 pixels, i.e. every 3 pairs of pixels
+  __m128i f[3];
+  for (int k = 0; k < 3; k++) {
+    Uint16 a[4], b[4];
+    port_postFactors(fx, 2 * k, y, a);
+    port_postFactors(fx, 2 * k + 1, y, b);
+    f[k] = _mm_setr_epi16(a[0], a[1], a[2], a[3], b[0], b[1], b[2], b[3]);
+  }
+  __m128i zero = _mm_setzero_si128();
+  int x = 0, k = 0;
+  for (; x + 4 <= n; x += 4) {
+    __m128i px = _mm_loadu_si128((__m128i *)(row + x));
+    __m128i lo = _mm_unpacklo_epi8(px, zero);
+    __m128i hi = _mm_unpackhi_epi8(px, zero);
+    lo = _mm_srli_epi16(_mm_mullo_epi16(lo, f[k]), 8);
+    k = k == 2 ? 0 : k + 1;
+    hi = _mm_srli_epi16(_mm_mullo_epi16(hi, f[k]), 8);
+    k = k == 2 ? 0 : k + 1;
+    _mm_storeu_si128((__m128i *)(row + x), _mm_packus_epi16(lo, hi));
+  }
+  for (; x < n; x++) { // the rest
+    Uint16 c[4];
+    port_postFactors(fx, x, y, c);
+    Uint8 *p = (Uint8 *)&row[x];
+    for (int i = 0; i < 4; i++) p[i] = (Uint8)((p[i] * c[i]) >> 8);
+  }
+}
+
+// the same, four pixels per saturating add
+static void port_postDitherSSE2(const PostFx *fx, Uint32 *row, int n, int y) {
+  int q = 8 - fx->ditherBits;
+  const Uint8 *b = port_bayer4[y & 3];
+  Uint8 t[4];
+  for (int i = 0; i < 4; i++) t[i] = (Uint8)((b[i] << q) >> 4);
+  // 4 pixels at x % 4 == 0 meet exactly one row of the Bayer matrix
+  __m128i thr = _mm_setr_epi8(t[0], t[0], t[0], 0, t[1], t[1], t[1], 0,
+                              t[2], t[2], t[2], 0, t[3], t[3], t[3], 0);
+  __m128i keep = _mm_set1_epi32((int)(0xff000000 | 0x10101 * (Uint8)(0xff << q)));
+  int x = 0;
+  for (; x + 4 <= n; x += 4) {
+    __m128i px = _mm_loadu_si128((__m128i *)(row + x));
+    px = _mm_and_si128(_mm_adds_epu8(px, thr), keep);
+    _mm_storeu_si128((__m128i *)(row + x), px);
+  }
+  Uint8 k = (Uint8)(0xff << q);
+  for (; x < n; x++) { // the rest
+    Uint8 *c = (Uint8 *)&row[x];
+    for (int i = 0; i < 3; i++) c[i] = (Uint8)(min(c[i] + t[x & 3], 255) & k);
+  }
+}
+#endif
+
+// run the whole chain on one row: SRC (upscaled, untouched) -> DST
+static void port_postRow(const PostFx *fx, const Uint32 *src, Uint32 *dst,
+  int n, int y) {
+  if (fx->grade) { // table lookups don't vectorize, but it's the first write
+    for (int x = 0; x < n; x++) {
+      Uint32 px = src[x];
+      dst[x] = (px & 0xff000000) | (Uint32)fx->lut[0][R8(px)] << 16 |
+               (Uint32)fx->lut[1][G8(px)] << 8 | fx->lut[2][B8(px)];
+    }
+  } else {
+    memcpy(dst, src, (size_t)n * 4);
+  }
+  // the following stages work in place on the row, it's hot in cache now
+  if (fx->mask || ((y & 1) && fx->scanline != 256)) {
+#ifdef PORT_SSE2
+    port_postScaleSSE2(fx, dst, n, y);
+#else
+    port_postScaleScalar(fx, dst, n, y);
+#endif
+  }
+  if (fx->ditherBits != 0) {
+#ifdef PORT_SSE2
+    port_postDitherSSE2(fx, dst, n, y);
+#else
+    port_postDitherScalar(fx, dst, n, y);
+#endif
+  }
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // VBUFFER ///////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
@@ -467,6 +2070,445 @@ static void port_interpolateOnto(Uint32 *src, Uint32 *dst,
   }
 }
 
+// upscale a single row applying horizontal scroll offset OFFX (0 <= offx < srcw)
+static void port_upscaleRow(const Uint32 *src, Uint32 *dst,
+  int srcw, int dstw, int offx) {
+
+  if (srcw == dstw) { // no scaling, just split the row at the wrap point
+    memcpy(dst, src + offx, (size_t)(srcw - offx) * 4);
+    memcpy(dst + (srcw - offx), src, (size_t)offx * 4);
+    return;
+  }
+  // nearest-neighbor, sx = floor(x * srcw / dstw) without a division per px
+  int sx = offx, err = 0;
+  for (int x = 0; x < dstw; x++) {
+    dst[x] = src[sx];
+    for (err += srcw; err >= dstw; err -= dstw) {
+      if (++sx == srcw) sx = 0;
+    }
+  }
+}
+
+// copy rows Y0..Y1 of the logical vbuffer onto DST (physical size) honoring
+// scroll registers and post effects, SCRATCH is a row for effects to read
+// [!] bands share nothing but SRC, so they can run in parallel
+static void port_presentBand(const Uint32 *src, Uint32 *dst, int y0, int y1,
+  Uint32 *scratch) {
+  int srcw = win->vbufw, srch = win->vbufh;
+  int dstw = win->bufw, dsth = win->bufh;
+  int offx = modWrap(win->scrollx, srcw);
+  int offy = modWrap(win->scrolly, srch);
+  const PostFx *fx = win->post;
+
+  int prevsy = -1;
+  for (int y = y0; y < y1; y++) {
+    int sy = (int)((Sint64)y * srch / dsth);
+    Uint32 *row = dst + (size_t)y * dstw;
+    if (sy != prevsy) {
+      prevsy = sy;
+      sy += offy;
+      if (sy >= srch) sy -= srch;
+      // effects vary per physical row, so they need the clean one kept aside
+      port_upscaleRow(src + (size_t)sy * srcw, fx ? scratch : row, srcw, dstw, offx);
+    } else if (fx == NULL) { // the same source row, duplicate the one above
+      memcpy(row, row - dstw, (size_t)dstw * 4);
+    }
+    if (fx != NULL) port_postRow(fx, scratch, row, dstw, y);
+  }
+}
+
+// copy logical vbuffer onto DST (physical size), see port_presentBand()
+static void port_present(const Uint32 *src, Uint32 *dst) {
+  Uint32 *scratch = win->post ? (Uint32 *)frameAlloc((size_t)win->bufw * 4) : NULL;
+  port_presentBand(src, dst, 0, win->bufh, scratch);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// FRAMEBUFFER SHARING ///////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+// The presented (physical) frame can be exported through a POSIX shared
+// memory segment, so local processes read it in place instead of receiving
+// copies. Segment layout:
+//   [FbShareHdr, padded to 4KB][slot 0: w*h ARGB][slot 1: w*h ARGB]
+// Upon update() the frame is produced straight into the slot consumers
+// aren't looking at, then published by flipping `front` under a seqlock.
+//
+// Writer                                 Reader
+//   seq = odd                              s1 = seq (retry while odd)
+//   render into slot !front                read front, dims, dirty ...
+//   front = !front, frame++, dirty         s2 = seq, retry if s1 != s2
+//   seq = even                             use slot[front] in place ...
+//                                          intact while seq - s1 <= 2
+// A slot is rewritten only two publications later, that's where the last
+// condition comes from (see fbShareAcquire() and fbShareIntact()). Resizing
+// moves the slots, so the writer then advances seq by extra 4 to fail every
+// outstanding check at once.
+// The dirty area spans the rows that differ from the previous frame (found
+// by comparing the two slots upon publishing), always the full width.
+// The segment only ever grows (on resize), consumers re-mmap once `size`
+// differs from what they've mapped; shrinking could SIGBUS their mappings.
+// [!] link with -lrt on glibc older than 2.34
+
+#define fbShareMAGIC   (0x54524f50) // "PORT" in memory
+#define fbShareVERSION (1)
+#define fbShareHDRSIZE (4096)       // slots start on a page boundary
+
+typedef struct FbShareHdr {
+  Uint32 magic;           // fbShareMAGIC
+  Uint32 version;         // fbShareVERSION
+  Uint64 size;            // whole segment size in bytes
+  Uint64 seq;             // seqlock counter, odd while being updated
+  Uint64 frame;           // number of the latest completed frame
+  Uint64 slotOffset[2];   // offsets of the frame slots from segment start
+  Uint32 front;           // slot holding the latest completed frame
+  Uint32 w, h;            // frame width/height in pixels
+  Uint32 stride;          // bytes per row
+  Uint32 format;          // SDL_PIXELFORMAT_ARGB8888
+  Uint32 dirtyx, dirtyy;  // area changed since the previous frame (rows)
+  Uint32 dirtyw, dirtyh;
+} FbShareHdr;
+
+// consumer's view of a published frame
+typedef struct FbShareFrame {
+  const Uint32 *px;       // first pixel of the frame (in the shared segment)
+  int w, h, stride;       // stride in bytes
+  Uint64 frame;           // frame number
+  Uint64 seq;             // seqlock value it was acquired at
+  SDL_Rect dirty;
+} FbShareFrame;
+
+typedef struct FbShare {
+  int fd;
+  char *name;             // shm object name (NULL if already unlinked)
+  char *mem;              // mapped segment
+  FbShareHdr *hdr;
+  bool fresh;             // front slot holds no comparable frame (new layout)
+} FbShare;
+
+#define fbShareRETRIES (100) // fbShareAcquire() gives up after ~100ms
+
+#ifndef _WIN32
+
+// (re)layout the segment for the current physical buffer size
+static void port_shareLayout(FbShare *sh) {
+  size_t frameSize = win->bufSize;
+  size_t size = fbShareHDRSIZE + 2 * frameSize;
+  FbShareHdr *hdr = sh->hdr;
+  if (hdr == NULL || size > hdr->size) { // grow the segment
+    // a named segment may outlive its writer (e.g. a crash), never shrink it
+    // under consumers that still have it mapped
+    struct stat st;
+    size_t have = hdr ? hdr->size : fstat(sh->fd, &st) == 0 ? (size_t)st.st_size : 0;
+    if (size > have) {
+      assertWithMsg(ftruncate(sh->fd, (off_t)size) == 0, "failed to size shared framebuffer");
+    } else {
+      size = have;
+    }
+    if (sh->mem != NULL) munmap(sh->mem, hdr->size);
+    sh->mem = (char *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, sh->fd, 0);
+    assertWithMsg(sh->mem != MAP_FAILED, "failed to map shared framebuffer");
+    sh->hdr = hdr = (FbShareHdr *)sh->mem;
+    hdr->size = size;
+  }
+  hdr->magic = fbShareMAGIC;
+  hdr->version = fbShareVERSION;
+  hdr->w = win->bufw;
+  hdr->h = win->bufh;
+  hdr->stride = win->bufw * 4;
+  hdr->format = SDL_PIXELFORMAT_ARGB8888;
+  hdr->slotOffset[0] = fbShareHDRSIZE;
+  hdr->slotOffset[1] = fbShareHDRSIZE + frameSize;
+  sh->fresh = true;
+}
+
+// export presented frames through shared memory object NAME (e.g. "/port"),
+// NULL creates an anonymous one (pass the returned fd to consumers instead)
+static int port_shareFramebuffer(const char *name) {
+  assertWithMsg(win->share == NULL, "framebuffer is already shared");
+  FbShare *sh = (FbShare *)calloc(1, sizeof(FbShare));
+  assertWithMsg(sh != NULL, "failed to allocate memory for shared framebuffer");
+
+  char tmpname[64];
+  if (name == NULL) { // unique name, unlinked right after opening
+    snprintf(tmpname, sizeof(tmpname), "/port-fb-%d-%p", (int)getpid(), (void *)sh);
+  }
+  sh->fd = shm_open(name ? name : tmpname, O_CREAT | O_RDWR, 0600);
+  assertWithMsg(sh->fd >= 0, "failed to create shared memory object");
+  if (name == NULL) {
+    shm_unlink(tmpname);
+  } else {
+    sh->name = strdup(name);
+  }
+
+  port_shareLayout(sh);
+  // forget whatever a previous writer left there: no frame is published yet
+  // and seq restarts, so frames held from the old run are no longer intact
+  FbShareHdr *hdr = sh->hdr;
+  hdr->frame = 0;
+  hdr->front = 0;
+  hdr->dirtyx = hdr->dirtyy = hdr->dirtyw = hdr->dirtyh = 0;
+  __atomic_store_n(&hdr->seq, 0, __ATOMIC_RELEASE);
+  win->share = sh;
+  return sh->fd;
+}
+
+// start a frame, returns the slot to render it into
+static Uint32 *port_shareBegin() {
+  FbShare *sh = win->share;
+  Uint64 seq = __atomic_load_n(&sh->hdr->seq, __ATOMIC_RELAXED);
+  __atomic_store_n(&sh->hdr->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE); // odd seq lands before any pixel
+  if (sh->hdr->w != (Uint32)win->bufw || sh->hdr->h != (Uint32)win->bufh) {
+    port_shareLayout(sh); // window was resized meanwhile
+    // slots moved over pixels readers may still hold, invalidate them all
+    // before any of those pixels get overwritten
+    __atomic_store_n(&sh->hdr->seq, seq + 5, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+  }
+  return (Uint32 *)(sh->mem + sh->hdr->slotOffset[sh->hdr->front ^ 1]);
+}
+
+// publish the frame rendered since port_shareBegin()
+static void port_shareEnd() {
+  FbShare *sh = win->share;
+  FbShareHdr *hdr = sh->hdr;
+  const char *cur = sh->mem + hdr->slotOffset[hdr->front ^ 1];
+  const char *prev = sh->mem + hdr->slotOffset[hdr->front];
+  // trim unchanged rows off the top and the bottom
+  Uint32 y0 = 0, y1 = hdr->h;
+  if (!sh->fresh) {
+    size_t stride = hdr->stride;
+    while (y0 < y1 && memcmp(cur + y0 * stride, prev + y0 * stride, stride) == 0) y0++;
+    while (y1 > y0 && memcmp(cur + (y1 - 1) * stride, prev + (y1 - 1) * stride, stride) == 0) y1--;
+  }
+  sh->fresh = false;
+  hdr->front ^= 1;
+  hdr->frame++;
+  bool dirty = y0 < y1; // empty rect if nothing changed
+  hdr->dirtyx = 0;
+  hdr->dirtyy = dirty ? y0 : 0;
+  hdr->dirtyw = dirty ? hdr->w : 0;
+  hdr->dirtyh = y1 - y0;
+  __atomic_store_n(&hdr->seq, hdr->seq + 1, __ATOMIC_RELEASE);
+}
+
+static void port_shareFree(FbShare *sh) {
+  if (sh == NULL) return;
+  munmap(sh->mem, sh->hdr->size);
+  close(sh->fd);
+  if (sh->name != NULL) {
+    shm_unlink(sh->name);
+    free(sh->name);
+  }
+  free(sh);
+}
+
+// [consumer] map an exported framebuffer read-only, by NAME or by FD (NAME
+// is NULL then), returns NULL if it's not there (yet)
+static const FbShareHdr *fbShareOpen(const char *name, int fd,
+  size_t *mappedSize) {
+  if (name != NULL) fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) return NULL;
+  struct stat st;
+  void *mem = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(FbShareHdr)) {
+    mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  if (name != NULL) close(fd); // the mapping stays valid
+  if (mem == MAP_FAILED) return NULL;
+  const FbShareHdr *hdr = (const FbShareHdr *)mem;
+  if (hdr->magic != fbShareMAGIC || hdr->version != fbShareVERSION) {
+    munmap(mem, st.st_size);
+    return NULL;
+  }
+  *mappedSize = st.st_size;
+  return hdr;
+}
+
+// [consumer] take the latest completed frame, false if none is published yet,
+// the segment outgrew the mapping of MAPPEDSIZE bytes (re-open it then) or
+// the writer stays mid-publish for fbShareRETRIES tries (it may be dead)
+static bool fbShareAcquire(const FbShareHdr *hdr, size_t mappedSize,
+  FbShareFrame *f) {
+  for (int tries = 0; tries < fbShareRETRIES; tries++) {
+    Uint64 s1 = __atomic_load_n(&hdr->seq, __ATOMIC_ACQUIRE);
+    if (s1 & 1) { // being published right now
+      SDL_Delay(1);
+      continue;
+    }
+    Uint32 front = hdr->front;
+    Uint64 size = hdr->size;
+    Uint64 offset = hdr->slotOffset[front];
+    f->w = hdr->w;
+    f->h = hdr->h;
+    f->stride = hdr->stride;
+    f->frame = hdr->frame;
+    f->dirty = (SDL_Rect){(int)hdr->dirtyx, (int)hdr->dirtyy,
+                          (int)hdr->dirtyw, (int)hdr->dirtyh};
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&hdr->seq, __ATOMIC_RELAXED) != s1) continue; // torn
+    if (f->frame == 0 || size > mappedSize) return false;
+    f->px = (const Uint32 *)((const char *)hdr + offset);
+    f->seq = s1;
+    return true;
+  }
+  return false;
+}
+
+// [consumer] check the pixels of F weren't overwritten while being read
+static bool fbShareIntact(const FbShareHdr *hdr, const FbShareFrame *f) {
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&hdr->seq, __ATOMIC_RELAXED) - f->seq <= 2;
+}
+
+#else // [TODO] CreateFileMapping() based implementation
+
+static int port_shareFramebuffer(const char *name) {
+  assertWithMsg(0, "framebuffer sharing is not supported on this platform");
+  return -1;
+}
+static Uint32 *port_shareBegin() { return NULL; }
+static void port_shareEnd() {}
+static void port_shareFree(FbShare *sh) {}
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+// ADAPTIVE RESOLUTION ///////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+// Optional controller trading logical resolution for frame rate. Every
+// update() it measures how long the frame took to draw and present (time
+// spent in wait() excluded) against a budget. Frames running late make it step
+// the logical size down right away, lasting headroom steps it back up. Buffers
+// for all steps are allocated upfront and the depth buffer (if there is one)
+// keeps the capacity of the full size, so switching never hits the heap.
+// [!] setLogicalSize(), UnsetLogicalSize() and resize() turn it off
+
+#define adaptMAXSTEPS    (8)
+#define adaptDOWNFRAMES  (3)     // late frames in a row to step down
+#define adaptUPFRAMES    (60)    // fast frames in a row to step up (initially)
+#define adaptHEADROOM    (0.6)   // "fast" is below this share of the budget
+
+typedef struct AdaptiveRes {
+  int nsteps;             // number of steps, 0 is the full logical size
+  int stepw[adaptMAXSTEPS], steph[adaptMAXSTEPS];
+  char *bufs[adaptMAXSTEPS]; // preallocated vbuffers (step 0 may be buf)
+  int step;               // current step
+
+  double budget;          // target frame time in seconds
+  int late, fast;         // frames in a row over budget / with headroom
+  int frames;             // frames since the last switch
+  int upFrames;           // fast frames required to step up, doubles each
+                          // time a step up gets reverted right away
+  bool wentUp;            // if the last switch was a step up
+  Uint64 frameStart;      // counter value the current frame started at
+  Uint64 waited;          // counter ticks spent in wait() since then
+
+  void (*onChange)(int w, int h); // called after logical size is switched
+} AdaptiveRes;
+
+// switch the vbuffer to step S, resampling what's drawn so far unless QUIET
+// (no resample and no onChange, for teardown)
+static void port_adaptSwitch(AdaptiveRes *a, int s, bool quiet) {
+  int w = a->stepw[s], h = a->steph[s];
+  if (!quiet) {
+    port_interpolateOnto((Uint32 *)win->vbuf, (Uint32 *)a->bufs[s],
+      win->vbufw, win->vbufh, w, h);
+  }
+  win->vbuf = a->bufs[s];
+  win->vbufw = w;
+  win->vbufh = h;
+  win->vbufSize = (size_t)w * h * 4;
+  a->wentUp = s < a->step;
+  a->step = s;
+  a->late = a->fast = a->frames = 0;
+  if (!quiet && a->onChange != NULL) a->onChange(w, h);
+}
+
+// stop the controller, logical size goes back to the full one (step 0)
+static void port_adaptOff(bool quiet) {
+  AdaptiveRes *a = win->adapt;
+  if (a == NULL) return;
+  if (a->step != 0) port_adaptSwitch(a, 0, quiet);
+  for (int s = 1; s < a->nsteps; s++) free(a->bufs[s]);
+  free(a);
+  win->adapt = NULL;
+}
+
+static void adaptiveResolutionOff() {
+  port_adaptOff(false);
+}
+
+// keep frames within TARGETMS milliseconds by scaling the current logical
+// size by one of SCALES (descending, first is 1; NULL for 1, 3/4, 1/2, 1/4),
+// ONCHANGE (optional) lets the app rescale its coordinates
+static void adaptiveResolution(double targetMs, const float *scales, int nsteps,
+  void (*onChange)(int w, int h)) {
+  static const float defaults[] = {1.0f, 0.75f, 0.5f, 0.25f};
+  if (scales == NULL) {
+    scales = defaults;
+    nsteps = sizeof(defaults) / sizeof(defaults[0]);
+  }
+  assertWithMsg(nsteps > 0 && nsteps <= adaptMAXSTEPS && scales[0] == 1.0f,
+    "adaptive resolution takes 1..8 scales starting with 1");
+  adaptiveResolutionOff();
+
+  AdaptiveRes *a = (AdaptiveRes *)calloc(1, sizeof(AdaptiveRes));
+  assertWithMsg(a != NULL, "failed to allocate memory for adaptive resolution");
+  a->nsteps = nsteps;
+  a->budget = targetMs / 1000;
+  a->upFrames = adaptUPFRAMES;
+  a->onChange = onChange;
+  // step 0 is the current vbuffer as is (logical or physical one)
+  a->stepw[0] = win->vbufw;
+  a->steph[0] = win->vbufh;
+  a->bufs[0] = win->vbuf;
+  for (int s = 1; s < nsteps; s++) {
+    assertWithMsg(scales[s] > 0 && scales[s] < scales[s - 1],
+      "adaptive resolution scales must be descending and above 0");
+    a->stepw[s] = max(1, (int)lrintf(win->vbufw * scales[s]));
+    a->steph[s] = max(1, (int)lrintf(win->vbufh * scales[s]));
+    a->bufs[s] = (char *)calloc((size_t)a->stepw[s] * a->steph[s], 4);
+    assertWithMsg(a->bufs[s] != NULL, "failed to allocate memory for adaptive resolution");
+  }
+  // 3D in use: smaller steps fit into the full size depth buffer
+  if (win->zbuf != NULL) port_depthReserve(a->stepw[0], a->steph[0]);
+  a->frameStart = SDL_GetPerformanceCounter();
+  win->adapt = a;
+}
+
+// account the frame that's just been presented, step if needed
+static void port_adaptFrame(AdaptiveRes *a) {
+  Uint64 now = SDL_GetPerformanceCounter();
+  Uint64 ticks = now - a->frameStart;
+  ticks = ticks > a->waited ? ticks - a->waited : 0;
+  double t = (double)ticks / SDL_GetPerformanceFrequency();
+  a->frameStart = now;
+  a->waited = 0;
+  a->frames++;
+
+  if (t > a->budget) {
+    a->fast = 0;
+    if (++a->late >= adaptDOWNFRAMES && a->step + 1 < a->nsteps) {
+      // the step up didn't hold, be more patient with the next one
+      if (a->wentUp && a->frames < a->upFrames) {
+        a->upFrames = min(a->upFrames * 2, adaptUPFRAMES * 64);
+      } else {
+        a->upFrames = adaptUPFRAMES;
+      }
+      port_adaptSwitch(a, a->step + 1, false);
+    }
+  } else if (t < a->budget * adaptHEADROOM) {
+    a->late = 0;
+    if (++a->fast >= a->upFrames && a->step > 0) {
+      port_adaptSwitch(a, a->step - 1, false);
+    }
+  } else { // within budget, no reason to move either way
+    a->late = a->fast = 0;
+  }
+}
 
 //////////////////////////////////////////////////////////////////////////////
 // WINDOW OPERATIONS /////////////////////////////////////////////////////////
@@ -494,14 +2536,24 @@ static void port_restore() {
 
 static void port_exit() {
   if (win != NULL) {
+    port_adaptOff(true); // the app is going away, don't call it back
     SDL_DestroyWindow(win->window);
     win->window = NULL;
     SDL_DestroyTexture(win->texture);
     win->texture = NULL;
     SDL_DestroyRenderer(win->renderer);
     win->renderer = NULL;
+    if (win->vbuf != win->buf) free(win->vbuf);
+    win->vbuf = NULL;
     free(win->buf);
     win->buf = NULL;
+    free(win->presentBuf);
+    win->presentBuf = NULL;
+    free(win->zbuf);
+    free(win->zmax);
+    arenaFree(win->frame);
+    port_shareFree(win->share);
+    free(win->post);
     free(win);
     win = NULL;
   }
@@ -514,7 +2566,10 @@ static void port_center() {
 }
 
 static void port_wait(Uint32 ms) {
+  Uint64 start = SDL_GetPerformanceCounter();
   SDL_Delay(ms);
+  // idle time isn't frame time
+  if (win->adapt != NULL) win->adapt->waited += SDL_GetPerformanceCounter() - start;
 }
 
 // clear buffer with predefined color
@@ -527,6 +2582,7 @@ static void port_clear() {
 static void port_resize(int w, int h) {
   // assert new window size does not oversize the screen
   assertWinSizeFitsScreen(w, h);
+  adaptiveResolutionOff(); // its buffers are sized after the old window
 
   // if logical size is set, assert new window size is >= the logical size
   if (win->vbuf != win->buf) {
@@ -592,6 +2648,17 @@ static void port_resize(int w, int h) {
 
   // remove old buffer
   free(oldbuf);
+  if (win->vbuf == (char *)oldbuf) { // no logical size, keep vbuf pointing at buf
+    win->vbuf = win->buf;
+    win->vbufw = win->bufw;
+    win->vbufh = win->bufh;
+    win->vbufSize = win->bufSize;
+  }
+
+  // presentation buffer gets recreated with the new size upon render
+  free(win->presentBuf);
+  win->presentBuf = NULL;
+  win->presented = NULL;
 
   // present a new one if the window is not closed
   if (win->isClosed) return;
@@ -600,14 +2667,31 @@ static void port_resize(int w, int h) {
 
 // render vbuffer to the screen
 static void port_update() {
+  char *out = win->buf;
+  // if pixels have to be moved or altered on the way to the screen
+  bool passes = win->scrollx != 0 || win->scrolly != 0 || win->post != NULL;
+  if (win->share != NULL) {
+    // render straight into the shared slot, it's what gets uploaded too
+    out = (char *)port_shareBegin();
+  } else if (win->vbuf == win->buf && passes) {
+    // vbuffer is the physical one, present it into a separate surface
+    if (win->presentBuf == NULL) {
+      win->presentBuf = (char *)malloc(win->bufSize);
+      assertWithMsg(win->presentBuf != NULL, "failed to allocate memory for presentation buffer");
+    }
+    out = win->presentBuf;
+  }
+
   // if logical buffer is present, interpolate it onto actual one
-  if (win->vbuf != win->buf) {
-    port_interpolateOnto((Uint32 *)win->vbuf, (Uint32 *)win->buf,
-      win->vbufw, win->vbufh,
-      win->bufw, win->bufh);
+  if (win->vbuf != win->buf || passes) {
+    port_present((Uint32 *)win->vbuf, (Uint32 *)out);
+  } else if (out != win->buf) { // the only copy, when nothing else moves px
+    memcpy(out, win->buf, win->bufSize);
   }
   // (!) texture and rendering buffer sizes are always the same
-  SDL_UpdateTexture(win->texture, NULL, win->buf, win->bufw * 4);
+  SDL_UpdateTexture(win->texture, NULL, out, win->bufw * 4);
+  win->presented = (Uint32 *)out;
+  if (win->share != NULL) port_shareEnd(); // the slot is complete, publish it
   // deliver vbuffer to the rendering target (through SDL texture)
   SDL_RenderCopy(win->renderer, win->texture, NULL,
     // &(SDL_Rect){0, 0, win->bufw, win->bufh} // already match (redudant)
@@ -616,24 +2700,40 @@ static void port_update() {
 
   // flip vbuffer
   SDL_RenderPresent(win->renderer);
+
+  // the frame is over, release its scratch memory
+  arenaReset(win->frame);
+  if (win->adapt != NULL) port_adaptFrame(win->adapt);
 }
 
 static void port_setPxRaw(int x, int y, Uint32 px) {
-  // locate px
-  unsigned int offs = win->vbufw * y + x;
-  // fill px with drawColor
-  *((Uint32 *)win->vbuf + offs) = px;
+  pxPut(canvasFromWindow(), x, y, px);
+}
+
+// set scroll registers: vbuffer pixel (x, y) becomes the top-left one on
+// screen, everything beyond the right/bottom edge wraps around
+static void port_setScroll(int x, int y) {
+  win->scrollx = x;
+  win->scrolly = y;
 }
 
 // set window logical size
 static void port_setLogicalSize(int w, int h) {
+  adaptiveResolutionOff(); // explicit size wins
   assertWithMsg((h <= win->bufh && w <= win->bufw) && (h != 0 && w != 0),
   "logic size cannot be 0 and must be less or equal to the current window size");
+  // drop the previous logical surface unless it can be reused as is
+  if (win->vbuf != win->buf && (win->vbufw != w || win->vbufh != h)) {
+    free(win->vbuf);
+    win->vbuf = win->buf;
+  }
+  if (win->vbuf == win->buf) {
+    win->vbuf = (char *)calloc(1, (size_t)w * h * 4);
+    assertWithMsg(win->vbuf != NULL, "failed to allocate memory for logical buffer");
+  }
   win->vbufw = w;
   win->vbufh = h;
-  win->vbufSize = w * h * 4;
-  win->vbuf = (char *)calloc(1, win->vbufSize);
-  assertWithMsg(win->vbuf != NULL, "failed to allocate memory for logical buffer");
+  win->vbufSize = (size_t)w * h * 4;
 
   // [optional] possibly use SDL functionality instead
   // SDL_RenderSetScale(win->renderer, 1.0, 1.0);
@@ -643,6 +2743,7 @@ static void port_setLogicalSize(int w, int h) {
 
 // set window logical size to match physical dimensions
 static void port_UnsetLogicalSize() {
+  adaptiveResolutionOff();
   if (win->vbuf == win->buf) return; // nothing to do
 
   // destroy logical rendering surface
@@ -776,7 +2877,7 @@ static void port_pollFor(int flags) {
 
 Window *newWindow(int width, int height) {
 
-  win = (Window *)malloc(sizeof(Window));
+  win = (Window *)calloc(1, sizeof(Window));
   assertWithMsg(win != 0, "failed to allocate memory for Window structure");
 
   // init SDL subsystems
@@ -808,6 +2909,9 @@ Window *newWindow(int width, int height) {
   win->vbuf = win->buf = (char *)calloc(sizeof(char), win->bufSize);
   assertWithMsg(win->buf != 0, "failed to allocate memory for video buffer");
 
+  // frame scratch memory (grows on demand up to the peak frame usage)
+  win->frame = arenaNew(64 * 1024);
+
   // (default) size of physical buffer == size of texture
   SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
                         SDL_TEXTUREACCESS_STREAMING, win->bufw, win->bufh);
@@ -824,6 +2928,7 @@ Window *newWindow(int width, int height) {
   win->close = port_close;
   win->exit = port_exit;
   win->center = port_center;
+  win->resize = port_resize;
   win->update = port_update;
   win->clear = port_clear;
 
@@ -836,6 +2941,8 @@ Window *newWindow(int width, int height) {
   win->setPxRaw = port_drawPxRaw;
   win->setLogicalSize = port_setLogicalSize;
   win->UnsetLogicalSize = port_UnsetLogicalSize;
+  win->setScroll = port_setScroll;
+  win->shareFramebuffer = port_shareFramebuffer;
 
   // windows events
   win->wait = port_wait;
@@ -854,10 +2961,346 @@ Window *newWindow(int width, int height) {
   win->drawLine = port_drawLine;
   win->drawPx = port_drawPx;
   win->drawPxRaw = port_drawPxRaw;
+  win->drawPixels = port_drawPixels;
+  win->drawImage = port_drawImage;
 
   return win;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// VERIFICATION //////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+// Tools to prove optimized paths produce the same pixels as plain ones:
+// - frame hashes compared against golden values stored in a text file
+//   ("name hash" per line), mismatching frames are dumped as PPM next to it
+// - verifyKernels() diffs every SIMD/blocked kernel against its scalar
+//   reference on random inputs
+// Runs headless with SDL_VIDEODRIVER=dummy, golden.c drives both checks
+// over a few scripted scenes (goldens in golden.txt).
+
+// fast non-cryptographic 64bit hash of N pixels (4 independent lanes)
+static Uint64 hashPixels(const Uint32 *px, size_t n) {
+  const Uint64 k = 0x9E3779B97F4A7C15ULL;
+  Uint64 h[4] = {k, k * 3, k * 5, k * 7};
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) { // 2 pixels per lane per step
+    for (int l = 0; l < 4; l++) {
+      Uint64 v = (Uint64)px[i + 2 * l] | (Uint64)px[i + 2 * l + 1] << 32;
+      h[l] = (h[l] ^ v) * k;
+      h[l] ^= h[l] >> 29;
+    }
+  }
+  Uint64 r = (Uint64)n * k;
+  for (; i < n; i++) r = (r ^ px[i]) * k;
+  for (int l = 0; l < 4; l++) r = ((r ^ h[l]) * k) ^ (r >> 31);
+  return r ^ (r >> 32);
+}
+
+// hash of the logical vbuffer, or of the last presented frame if PHYSICAL
+static Uint64 frameHash(bool physical) {
+  if (!physical) return hashPixels((Uint32 *)win->vbuf, (size_t)win->vbufw * win->vbufh);
+  assertWithMsg(win->presented != NULL, "nothing is presented yet, call update() first");
+  return hashPixels(win->presented, (size_t)win->bufw * win->bufh);
+}
+
+// write N*W pixels as binary PPM (alpha is dropped)
+static bool imageSavePPM(const char *path, const Uint32 *px, int w, int h) {
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) return false;
+  fprintf(f, "P6\n%d %d\n255\n", w, h);
+  for (size_t i = 0; i < (size_t)w * h; i++) {
+    Uint8 rgb[3] = {R8(px[i]), G8(px[i]), B8(px[i])};
+    fwrite(rgb, 1, 3, f);
+  }
+  return fclose(f) == 0;
+}
+
+// compare HASH of frame NAME against the golden FILE, unknown names are
+// recorded (appended), returns false on mismatch
+static bool goldenCheck(const char *file, const char *name, Uint64 hash) {
+  FILE *f = fopen(file, "r");
+  char line[256];
+  while (f != NULL && fgets(line, sizeof(line), f) != NULL) {
+    char key[200];
+    unsigned long long golden;
+    if (sscanf(line, "%199s %llx", key, &golden) != 2 || strcmp(key, name) != 0) continue;
+    fclose(f);
+    if (golden == hash) return true;
+    printf("[golden] %s: expected %016llx, got %016llx\n",
+      name, golden, (unsigned long long)hash);
+    return false;
+  }
+  if (f != NULL) fclose(f);
+  f = fopen(file, "a");
+  assertWithMsg(f != NULL, "cannot open golden file for writing");
+  fprintf(f, "%s %016llx\n", name, (unsigned long long)hash);
+  fclose(f);
+  printf("[golden] %s: recorded\n", name);
+  return true;
+}
+
+// render SCENE (drawing through the public Window API) and check both the
+// logical and the presented frame against golden FILE as NAME and NAME.phys,
+// mismatching frames are saved as FILE.NAME[.phys].ppm
+static bool goldenScene(const char *file, const char *name, void (*scene)()) {
+  scene();
+  win->update();
+  bool ok = true;
+  for (int physical = 0; physical < 2; physical++) {
+    char key[200], path[512];
+    snprintf(key, sizeof(key), physical ? "%s.phys" : "%s", name);
+    if (goldenCheck(file, key, frameHash(physical))) continue;
+    ok = false;
+    snprintf(path, sizeof(path), "%s.%s.ppm", file, key);
+    if (physical) imageSavePPM(path, win->presented, win->bufw, win->bufh);
+    else imageSavePPM(path, (Uint32 *)win->vbuf, win->vbufw, win->vbufh);
+  }
+  return ok;
+}
+
+// xorshift32, deterministic inputs for verifyKernels()
+static Uint32 port_rand(Uint32 *state) {
+  Uint32 x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+// count and report a mismatch of KERNEL into FAILS unless COND holds
+#define port_verify(fails, cond, kernel, it) do { \
+  if (!(cond)) { \
+    printf("[verify] %s differs from its reference (iteration %d)\n", kernel, it); \
+    (fails)++; \
+  } \
+} while (0)
+
+#define port_verifyTRIS (6) // triangles drawn over each other per iteration
+
+// brute force pixel coverage of a (snapped) triangle, reference for the
+// blocked rasterizer, same winding and fill rules
+static bool port_refCovers(const RasterVert *v, int px, int py) {
+  Sint64 area2 = (v[1].x - v[0].x) * (v[2].y - v[0].y) -
+                 (v[1].y - v[0].y) * (v[2].x - v[0].x);
+  if (area2 == 0) return false;
+  const RasterVert *t[3] = {&v[0], area2 < 0 ? &v[2] : &v[1], area2 < 0 ? &v[1] : &v[2]};
+  Sint64 x = (Sint64)px * 16 + 8, y = (Sint64)py * 16 + 8;
+  for (int i = 0; i < 3; i++) {
+    const RasterVert *a = t[i], *b = t[(i + 1) % 3];
+    Sint64 dx = b->x - a->x, dy = b->y - a->y;
+    Sint64 e = dx * (y - a->y) - dy * (x - a->x);
+    bool topLeft = dy < 0 || (dy == 0 && dx > 0);
+    if (e < 0 || (e == 0 && !topLeft)) return false;
+  }
+  return true;
+}
+
+// diff optimized kernels against their scalar references on ITERATIONS
+// random inputs each, returns the number of mismatches (0 is good)
+static int verifyKernels(int iterations, Uint32 seed) {
+  Uint32 rnd = seed ? seed : 1;
+  int fails = 0;
+  #define port_randf() ((int)(port_rand(&rnd) % 2001 - 1000) / 100.0f)
+
+  for (int it = 0; it < iterations; it++) {
+    // 4x4 matrices & batched vertex transform
+    Mat4 a, b;
+    for (int i = 0; i < 16; i++) a.m[i] = port_randf(), b.m[i] = port_randf();
+    Mat4 r1 = mat4Mul(&a, &b), r2 = port_mat4MulScalar(&a, &b);
+    port_verify(fails, memcmp(&r1, &r2, sizeof(Mat4)) == 0, "mat4Mul", it);
+
+    float xyz[3 * 17];
+    Vec4 v1[17], v2[17];
+    for (int i = 0; i < 3 * 17; i++) xyz[i] = port_randf();
+    transformVertices(&a, xyz, v1, 17);
+    port_transformScalar(&a, xyz, v2, 17);
+    port_verify(fails, memcmp(v1, v2, sizeof(v1)) == 0, "transformVertices", it);
+
+    // 24bit -> ARGB conversion
+    Uint8 raw[3 * 37];
+    Uint32 p1[37], p2[37];
+    for (int i = 0; i < 3 * 37; i++) raw[i] = (Uint8)port_rand(&rnd);
+    int n = 1 + port_rand(&rnd) % 37;
+    bool bgr = port_rand(&rnd) & 1;
+    port_px24ToARGB(raw, p1, n, bgr);
+    port_px24ToARGBScalar(raw, p2, n, bgr);
+    port_verify(fails, memcmp(p1, p2, n * 4) == 0, "px24ToARGB", it);
+
+    // post effects
+#ifdef PORT_SSE2
+    PostFx fx = {0};
+    fx.scanline = port_rand(&rnd) % 257;
+    fx.mask = port_rand(&rnd) & 1;
+    fx.ditherBits = 1 + port_rand(&rnd) % 7;
+    int y = port_rand(&rnd) % 8;
+    for (int i = 0; i < 37; i++) p1[i] = p2[i] = port_rand(&rnd);
+    port_postScaleSSE2(&fx, p1, n, y);
+    port_postScaleScalar(&fx, p2, n, y);
+    port_verify(fails, memcmp(p1, p2, n * 4) == 0, "postScale", it);
+    port_postDitherSSE2(&fx, p1, n, y);
+    port_postDitherScalar(&fx, p2, n, y);
+    port_verify(fails, memcmp(p1, p2, n * 4) == 0, "postDither", it);
+#endif
+
+    // upscale row (stepping) vs direct floor(x * srcw / dstw)
+    Uint32 src[37], up[111];
+    int srcw = 1 + port_rand(&rnd) % 37;
+    int dstw = srcw + port_rand(&rnd) % (111 - srcw + 1);
+    int offx = port_rand(&rnd) % srcw;
+    for (int i = 0; i < srcw; i++) src[i] = port_rand(&rnd);
+    port_upscaleRow(src, up, srcw, dstw, offx);
+    bool same = true;
+    for (int x = 0; x < dstw; x++) {
+      same &= up[x] == src[(int)(((Sint64)x * srcw / dstw + offx) % srcw)];
+    }
+    port_verify(fails, same, "upscaleRow", it);
+
+    // particles, odd count so both the vector body and the tail run
+    Particles *pa = particlesNew(37), *pb = particlesNew(37);
+    int np = 1 + 2 * (port_rand(&rnd) % 18);
+    for (int i = 0; i < np; i++) {
+      float x = port_randf(), y = port_randf(), vx = port_randf(), vy = port_randf();
+      particlesAdd(pa, x, y, vx, vy, 0);
+      particlesAdd(pb, x, y, vx, vy, 0);
+    }
+    float dt = (port_rand(&rnd) % 100 + 1) / 1000.0f, ax = port_randf(), ay = port_randf();
+    particlesStep(pa, dt, ax, ay);
+    port_particlesStepScalar(pb, 0, dt, ax, ay);
+    port_verify(fails, memcmp(pa->x, pb->x, np * 4) == 0 && memcmp(pa->y, pb->y, np * 4) == 0 &&
+      memcmp(pa->vx, pb->vx, np * 4) == 0 && memcmp(pa->vy, pb->vy, np * 4) == 0,
+      "particlesStep", it);
+    particlesFree(pa);
+    particlesFree(pb);
+  }
+  #undef port_randf
+
+  // blocked rasterizer vs brute force coverage & depth, on a private 61x43
+  // target, several overlapping triangles per iteration so hierarchical
+  // depth rejects get exercised too
+  char *vbuf = win->vbuf;
+  int vbufw = win->vbufw, vbufh = win->vbufh;
+  float *zbuf = win->zbuf, *zmax = win->zmax;
+  int zbufw = win->zbufw, zbufh = win->zbufh;
+  size_t zbufCap = win->zbufCap, zmaxCap = win->zmaxCap;
+  int w = 61, h = 43, ntris = port_verifyTRIS;
+  size_t npx = (size_t)w * h, nblocks = (size_t)((w + 7) / 8) * ((h + 7) / 8);
+  Uint32 *target = (Uint32 *)malloc(npx * 4);
+  Uint32 *ref = (Uint32 *)malloc(npx * 4);
+  float *refz = (float *)malloc(npx * sizeof(float));
+  assertWithMsg(target && ref && refz, "failed to allocate memory for verification");
+  win->vbuf = (char *)target;
+  win->vbufw = w;
+  win->vbufh = h;
+  win->zbuf = NULL;
+  win->zmax = NULL;
+  win->zbufCap = win->zmaxCap = 0;
+  for (int it = 0; it < iterations; it++) {
+    RasterVert v[port_verifyTRIS][3], c[3];
+    for (int t = 0; t < ntris; t++) {
+      // constant depth per triangle, so the per pixel one is exact anywhere
+      float z = (port_rand(&rnd) % 1000 + 1) / 1001.0f;
+      for (int i = 0; i < 3; i++) {
+        v[t][i] = (RasterVert){(Sint64)(port_rand(&rnd) % (w * 24)) - w * 4,
+                               (Sint64)(port_rand(&rnd) % (h * 24)) - h * 4, z, 0, 0, 0};
+      }
+    }
+    memSet32(target, 0, npx);
+    depthClear();
+    for (int t = 0; t < ntris; t++) {
+      memcpy(c, v[t], sizeof(c));
+      port_rasterTriangle(c, cullNONE, 0xff000000 | (t + 1));
+    }
+    memSet32(ref, 0, npx);
+    for (size_t i = 0; i < npx; i++) refz[i] = 1.0f;
+    for (int t = 0; t < ntris; t++) {
+      for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+          size_t i = (size_t)y * w + x;
+          if (!port_refCovers(v[t], x, y) || v[t][0].z >= refz[i]) continue;
+          refz[i] = v[t][0].z;
+          ref[i] = 0xff000000 | (t + 1);
+        }
+      }
+    }
+    port_verify(fails, memcmp(target, ref, npx * 4) == 0, "rasterTriangle", it);
+
+    // sloped depths: hierarchical rejects vs none (block maximums kept far)
+    for (int t = 0; t < ntris; t++) {
+      for (int i = 0; i < 3; i++) v[t][i].z = (port_rand(&rnd) % 1000 + 1) / 1001.0f;
+    }
+    memSet32(target, 0, npx);
+    depthClear();
+    for (int t = 0; t < ntris; t++) {
+      memcpy(c, v[t], sizeof(c));
+      port_rasterTriangle(c, cullNONE, 0xff000000 | (t + 1));
+    }
+    memcpy(ref, target, npx * 4);
+    memSet32(target, 0, npx);
+    depthClear();
+    for (int t = 0; t < ntris; t++) {
+      for (size_t i = 0; i < nblocks; i++) win->zmax[i] = INFINITY;
+      memcpy(c, v[t], sizeof(c));
+      port_rasterTriangle(c, cullNONE, 0xff000000 | (t + 1));
+    }
+    port_verify(fails, memcmp(target, ref, npx * 4) == 0, "rasterTriangle (depth)", it);
+  }
+
+  // tilemap ring: incrementally scrolled layer vs one fully redrawn at the
+  // same position (odd tile and map sizes, some scrolls past the ring size)
+  Uint32 atlas[4 * 5 * 3];
+  for (int i = 0; i < 4 * 5 * 3; i++) atlas[i] = port_rand(&rnd);
+  Tileset *ts = tilesetNew(atlas, 4 * 5, 3, 5, 3);
+  Tilemap *tm = tilemapNew(ts, 7, 5), *full = tilemapNew(ts, 7, 5);
+  for (int i = 0; i < 7 * 5; i++) full->map[i] = tm->map[i] = port_rand(&rnd) % 4;
+  int scrollx = win->scrollx, scrolly = win->scrolly;
+  win->vbuf = (char *)target;
+  tilemapDraw(tm);
+  for (int it = 0; it < iterations; it++) {
+    int big = port_rand(&rnd) % 16 == 0; // take the full redraw path now and then
+    int range = big ? 2 * w : 9;
+    tilemapScroll(tm, (int)(port_rand(&rnd) % (2 * range + 1)) - range,
+                      (int)(port_rand(&rnd) % (2 * range + 1)) - range);
+    if (port_rand(&rnd) % 4 == 0) { // and change a tile while it's visible
+      int tx = port_rand(&rnd) % 7, ty = port_rand(&rnd) % 5;
+      Uint16 idx = port_rand(&rnd) % 4;
+      tilemapSet(tm, tx, ty, idx);
+      full->map[ty * 7 + tx] = idx;
+    }
+    int sx = win->scrollx, sy = win->scrolly;
+    win->vbuf = (char *)ref;
+    full->x = tm->x;
+    full->y = tm->y;
+    tilemapDraw(full);
+    bool same = memcmp(target, ref, npx * 4) == 0 &&
+      sx == win->scrollx && sy == win->scrolly;
+    port_verify(fails, same, "tilemapScroll", it);
+    win->vbuf = (char *)target;
+  }
+  tilemapFree(tm);
+  tilemapFree(full);
+  tilesetFree(ts);
+  win->scrollx = scrollx;
+  win->scrolly = scrolly;
+
+  free(target);
+  free(ref);
+  free(refz);
+  free(win->zbuf);
+  free(win->zmax);
+  win->vbuf = vbuf;
+  win->vbufw = vbufw;
+  win->vbufh = vbufh;
+  win->zbuf = zbuf;
+  win->zmax = zmax;
+  win->zbufw = zbufw;
+  win->zbufh = zbufh;
+  win->zbufCap = zbufCap;
+  win->zmaxCap = zmaxCap;
+
+  return fails;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // BENCHMARKING //////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////